@@ -13,18 +13,368 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+
+/*
+ * Dumps ibus-cfg.eet, the snapshot published in shared memory by a running
+ * weekeyboard, or measures the config store on a scratch file:
+ *
+ *    ./weekeyboard-config-eet-test [--shm]
+ *    ./weekeyboard-config-eet-test --bench [--machine] [iterations]
+ *
+ * Each benchmark reports operations per second and the p99 latency. With
+ * --machine, one tab separated line is printed per benchmark instead: name,
+ * iterations, operations per second and p99 latency in microseconds.
+ *
+ * set-mem and set-list-mem only change values in memory, the flush delay
+ * never expires while benchmarking. set-commit also writes the file out,
+ * as every set used to. open-cold drops the Eet cache only, the file may
+ * still be in the page cache.
+ */
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include <Ecore.h>
 #include <Eet.h>
+#include <Eldbus.h>
 
 #include "wkb-ibus-config-eet.h"
+#include "wkb-ibus-config-shm.h"
+#include "wkb-ibus-defs.h"
 #include "wkb-log.h"
 
+#define BENCH_ITERATIONS 10000
+#define BENCH_FILE "config-bench.eet"
+#define BENCH_LIST_SIZE 256
+
+/* Opening and committing write the whole file, run them fewer times */
+#define BENCH_OPEN_DIVISOR 10
+
+struct _bench
+{
+   unsigned int iterations;
+   double *samples;
+   Eina_Bool machine;
+};
+
+static const char *_bench_sections[] = {
+   "general", "general/hotkey", "panel", "engine/hangul", "engine/pinyin",
+   "engine/bopomofo", "weekeyboard", NULL
+};
+
+static double
+_bench_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static int
+_bench_sample_cmp(const void *a, const void *b)
+{
+   double x = *(const double *) a, y = *(const double *) b;
+
+   return (x > y) - (x < y);
+}
+
+static void
+_bench_report(struct _bench *bench, const char *name, unsigned int n)
+{
+   double total = 0, p99;
+   unsigned int i;
+
+   for (i = 0; i < n; i++)
+      total += bench->samples[i];
+
+   qsort(bench->samples, n, sizeof(double), _bench_sample_cmp);
+   p99 = bench->samples[(n * 99 + 99) / 100 - 1];
+
+   if (bench->machine)
+      printf("%s\t%u\t%.1f\t%.3f\n", name, n, n / total, p99 * 1000000.0);
+   else
+      printf("%-12s %8u ops %12.1f ops/s %10.3f us p99\n", name, n, n / total, p99 * 1000000.0);
+}
+
+/* SetValue style message holding only the variant, read back as 'v' */
+static Eldbus_Message *
+_bench_value_new(void)
+{
+   return eldbus_message_method_call_new(IBUS_SERVICE_CONFIG, IBUS_PATH_CONFIG, IBUS_INTERFACE_CONFIG, "SetValue");
+}
+
+static Eldbus_Message *
+_bench_value_int_new(int value)
+{
+   Eldbus_Message *msg = _bench_value_new();
+   Eldbus_Message_Iter *iter = eldbus_message_iter_get(msg);
+   Eldbus_Message_Iter *variant = eldbus_message_iter_container_new(iter, 'v', "i");
+
+   eldbus_message_iter_basic_append(variant, 'i', value);
+   eldbus_message_iter_container_close(iter, variant);
+
+   return msg;
+}
+
+static Eldbus_Message *
+_bench_value_list_new(unsigned int seed)
+{
+   Eldbus_Message *msg = _bench_value_new();
+   Eldbus_Message_Iter *iter = eldbus_message_iter_get(msg);
+   Eldbus_Message_Iter *variant = eldbus_message_iter_container_new(iter, 'v', "as");
+   Eldbus_Message_Iter *array = eldbus_message_iter_container_new(variant, 'a', "s");
+   char buf[32];
+   unsigned int i;
+
+   for (i = 0; i < BENCH_LIST_SIZE; i++)
+     {
+        snprintf(buf, sizeof(buf), "xkb:bench:%u:%u", seed, i);
+        eldbus_message_iter_basic_append(array, 's', buf);
+     }
+
+   eldbus_message_iter_container_close(variant, array);
+   eldbus_message_iter_container_close(iter, variant);
+
+   return msg;
+}
+
+/* cold: Eet file cache dropped before each open, warm: left in place */
+static void
+_bench_open(struct _bench *bench, const char *name, Eina_Bool cold)
+{
+   struct wkb_ibus_config_eet *cfg;
+   unsigned int i, n = bench->iterations / BENCH_OPEN_DIVISOR;
+   double start;
+
+   if (!n)
+      n = 1;
+
+   for (i = 0; i < n; i++)
+     {
+        if (cold)
+           eet_clearcache();
+
+        start = _bench_now();
+        cfg = wkb_ibus_config_eet_new(BENCH_FILE, NULL);
+        bench->samples[i] = _bench_now() - start;
+        wkb_ibus_config_eet_free(cfg);
+     }
+
+   _bench_report(bench, name, n);
+}
+
+static void
+_bench_read_all(struct _bench *bench, struct wkb_ibus_config_eet *cfg)
+{
+   Eldbus_Message *msg;
+   Eldbus_Message_Iter *iter;
+   unsigned int i, j;
+   double start;
+
+   for (i = 0; i < bench->iterations; i++)
+     {
+        msg = _bench_value_new();
+        iter = eldbus_message_iter_get(msg);
+
+        start = _bench_now();
+        for (j = 0; _bench_sections[j]; j++)
+           wkb_ibus_config_eet_get_values(cfg, _bench_sections[j], iter);
+        bench->samples[i] = _bench_now() - start;
+
+        eldbus_message_unref(msg);
+     }
+
+   _bench_report(bench, "read-all", bench->iterations);
+}
+
+static void
+_bench_get_values(struct _bench *bench, struct wkb_ibus_config_eet *cfg)
+{
+   Eldbus_Message *msg;
+   unsigned int i;
+   double start;
+
+   for (i = 0; i < bench->iterations; i++)
+     {
+        msg = _bench_value_new();
+
+        start = _bench_now();
+        wkb_ibus_config_eet_get_values(cfg, "engine/pinyin", eldbus_message_iter_get(msg));
+        bench->samples[i] = _bench_now() - start;
+
+        eldbus_message_unref(msg);
+     }
+
+   _bench_report(bench, "get-values", bench->iterations);
+}
+
+static void
+_bench_get(struct _bench *bench, struct wkb_ibus_config_eet *cfg)
+{
+   volatile int value;
+   unsigned int i;
+   double start;
+
+   for (i = 0; i < bench->iterations; i++)
+     {
+        start = _bench_now();
+        value = wkb_ibus_config_eet_get_value_int(cfg, "panel", "lookup-table-orientation");
+        bench->samples[i] = _bench_now() - start;
+     }
+
+   (void) value;
+   _bench_report(bench, "get", bench->iterations);
+}
+
+static void
+_bench_set(struct _bench *bench, struct wkb_ibus_config_eet *cfg, const char *name, Eina_Bool list)
+{
+   Eldbus_Message *msg;
+   Eldbus_Message_Iter *value;
+   unsigned int i;
+   double start;
+
+   for (i = 0; i < bench->iterations; i++)
+     {
+        /* Alternate values so every write is an actual change */
+        msg = list ? _bench_value_list_new(i % 2) : _bench_value_int_new(i % 2);
+
+        if (!eldbus_message_arguments_get(msg, "v", &value))
+          {
+             ERR("Error reading back benchmark value");
+             eldbus_message_unref(msg);
+             return;
+          }
+
+        start = _bench_now();
+        if (list)
+           wkb_ibus_config_eet_set_value(cfg, "general", "preload-engines", value);
+        else
+           wkb_ibus_config_eet_set_value(cfg, "panel", "x", value);
+        bench->samples[i] = _bench_now() - start;
+
+        eldbus_message_unref(msg);
+     }
+
+   _bench_report(bench, name, bench->iterations);
+}
+
+/* A change written out right away, instead of after the flush delay */
+static void
+_bench_set_commit(struct _bench *bench, struct wkb_ibus_config_eet *cfg)
+{
+   Eldbus_Message *msg;
+   Eldbus_Message_Iter *value;
+   unsigned int i, n = bench->iterations / BENCH_OPEN_DIVISOR;
+   double start;
+
+   if (!n)
+      n = 1;
+
+   for (i = 0; i < n; i++)
+     {
+        msg = _bench_value_int_new(i % 2);
+
+        if (!eldbus_message_arguments_get(msg, "v", &value))
+          {
+             ERR("Error reading back benchmark value");
+             eldbus_message_unref(msg);
+             return;
+          }
+
+        start = _bench_now();
+        wkb_ibus_config_eet_set_value(cfg, "panel", "x", value);
+        wkb_ibus_config_eet_commit(cfg);
+        bench->samples[i] = _bench_now() - start;
+
+        eldbus_message_unref(msg);
+     }
+
+   _bench_report(bench, "set-commit", n);
+}
+
+static int
+_bench_run(unsigned int iterations, Eina_Bool machine)
+{
+   struct _bench bench;
+   struct wkb_ibus_config_eet *cfg;
+   int ret = 1;
+
+   if (!ecore_init())
+      return 1;
+
+   if (!eldbus_init())
+     {
+        ERR("Error initializing Eldbus");
+        goto eldbus_err;
+     }
+
+   bench.iterations = iterations;
+   bench.machine = machine;
+   bench.samples = calloc(iterations, sizeof(double));
+
+   unlink(BENCH_FILE);
+
+   if (!machine)
+      printf("%u iterations, %d element lists\n", iterations, BENCH_LIST_SIZE);
+
+   _bench_open(&bench, "open-cold", EINA_TRUE);
+   _bench_open(&bench, "open-warm", EINA_FALSE);
+
+   if (!(cfg = wkb_ibus_config_eet_new(BENCH_FILE, NULL)))
+     {
+        ERR("Error opening '%s'", BENCH_FILE);
+        goto end;
+     }
+
+   _bench_read_all(&bench, cfg);
+   _bench_get_values(&bench, cfg);
+   _bench_get(&bench, cfg);
+   _bench_set(&bench, cfg, "set-mem", EINA_FALSE);
+   _bench_set(&bench, cfg, "set-list-mem", EINA_TRUE);
+   _bench_set_commit(&bench, cfg);
+
+   wkb_ibus_config_eet_free(cfg);
+   ret = 0;
+
+end:
+   unlink(BENCH_FILE);
+   free(bench.samples);
+   eldbus_shutdown();
+
+eldbus_err:
+   ecore_shutdown();
+
+   return ret;
+}
+
 int
 main (int argc, char *argv[])
 {
-   int ret = 1;
+   int i, ret = 1;
+   unsigned int iterations = BENCH_ITERATIONS;
+   Eina_Bool bench = EINA_FALSE, machine = EINA_FALSE, shm = EINA_FALSE;
    struct wkb_ibus_config_eet *cfg;
+   struct wkb_ibus_config_snapshot *snapshot;
+
+   for (i = 1; i < argc; i++)
+     {
+        if (strcmp(argv[i], "--bench") == 0)
+           bench = EINA_TRUE;
+        else if (strcmp(argv[i], "--machine") == 0)
+           machine = EINA_TRUE;
+        else if (strcmp(argv[i], "--shm") == 0)
+           shm = EINA_TRUE;
+        else
+           iterations = strtoul(argv[i], NULL, 10);
+     }
+
+   if (!iterations)
+      return 1;
 
    if (!wkb_log_init("eet-test"))
       return 1;
@@ -35,10 +385,32 @@ main (int argc, char *argv[])
         goto eet_err;
      }
 
+   if (bench)
+     {
+        ret = _bench_run(iterations, machine);
+        goto end;
+     }
+
+   if (shm)
+     {
+        if (!(snapshot = wkb_ibus_config_snapshot_get(wkb_ibus_config_shm_name())))
+          {
+             ERR("Nothing published in shared memory '%s'", wkb_ibus_config_shm_name());
+             goto end;
+          }
+
+        wkb_ibus_config_snapshot_dump(snapshot);
+        wkb_ibus_config_snapshot_free(snapshot);
+        ret = 0;
+        goto end;
+     }
+
    cfg = wkb_ibus_config_eet_new("ibus-cfg.eet", NULL);
    wkb_ibus_config_eet_dump(cfg);
    wkb_ibus_config_eet_free(cfg);
    ret = 0;
+
+end:
    wkb_ibus_config_eet_shutdown();
 
 eet_err:
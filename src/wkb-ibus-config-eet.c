@@ -20,29 +20,41 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string.h>
-#include <strings.h>
+#include <limits.h>
+#include <fcntl.h>
 
 #include <Eina.h>
+#include <Ecore.h>
 #include <Eet.h>
 #include <Eldbus.h>
 
 #include "wkb-ibus-config-eet.h"
 #include "wkb-ibus-config-key.h"
+#include "wkb-ibus-config-shm.h"
 #include "wkb-log.h"
 
 /*
  * Eet Data Descriptors
+ *
+ * Every section holding keys is stored in its own Eet entry, named after the
+ * section id. Container sections have no entry.
  */
-static Eet_Data_Descriptor *_ibus_edd;
 static Eet_Data_Descriptor *_general_edd;
 static Eet_Data_Descriptor *_hotkey_edd;
 static Eet_Data_Descriptor *_panel_edd;
-static Eet_Data_Descriptor *_engine_edd;
 static Eet_Data_Descriptor *_hangul_edd;
 static Eet_Data_Descriptor *_pinyin_edd;
 static Eet_Data_Descriptor *_bopomofo_edd;
 static Eet_Data_Descriptor *_weekeyboard_edd;
 
+/*
+ * Older versions stored the whole ibus tree in a single 'ibus' entry, these
+ * are only used to migrate it.
+ */
+static Eet_Data_Descriptor *_ibus_legacy_edd;
+static Eet_Data_Descriptor *_general_legacy_edd;
+static Eet_Data_Descriptor *_engine_legacy_edd;
+
 /*
  * Base struct for all config types
  */
@@ -50,22 +62,119 @@ struct _config_section
 {
    const char *id;
    Eina_List *keys;
+   Eina_Hash *keys_index; /* canonical key id -> struct wkb_config_key */
    Eina_List *subsections;
    Eet_Data_Descriptor *edd;
+   const struct _config_key_desc *keys_desc; /* NULL for container sections */
    struct _config_section *parent;
+   Eina_List *callbacks; /* struct _config_callback, called for any key */
+   struct _config_values *values; /* GetValues snapshot, NULL when stale */
 
    void (*set_defaults)(struct _config_section *);
    Eina_Bool (*update)(struct _config_section *);
 };
 
+struct _config_callback
+{
+   wkb_config_key_changed_cb cb;
+   const void *data;
+};
+
+/*
+ * Engines ask for their whole section with GetValues on every activation.
+ * Eldbus cannot append already marshalled data, so the section keeps its keys
+ * resolved to their values in a flat array instead, rebuilt on the first
+ * GetValues after any of them changed.
+ */
+struct _config_values_entry
+{
+   const char *id;
+   const char *signature;
+   union wkb_config_value value;
+};
+
+struct _config_values
+{
+   unsigned int count;
+   struct _config_values_entry entries[];
+};
+
+static struct _config_values *
+_config_values_new(struct _config_section *base)
+{
+   struct _config_values *values;
+   struct wkb_config_key *key;
+   Eina_List *node;
+   unsigned int i = 0;
+
+   values = malloc(sizeof(*values) + eina_list_count(base->keys) * sizeof(struct _config_values_entry));
+
+   EINA_LIST_FOREACH(base->keys, node, key)
+     {
+        values->entries[i].id = wkb_config_key_id(key);
+        values->entries[i].signature = wkb_config_key_signature(key);
+        wkb_config_key_value_get(key, &values->entries[i].value);
+        i++;
+     }
+
+   values->count = i;
+   return values;
+}
+
+static void
+_config_values_append(struct _config_values *values, Eldbus_Message_Iter *dict)
+{
+   Eldbus_Message_Iter *entry, *variant, *array;
+   const struct _config_values_entry *e;
+   const Eina_List *node;
+   const char *str;
+   unsigned int i;
+
+   for (i = 0; i < values->count; i++)
+     {
+        e = &values->entries[i];
+
+        entry = eldbus_message_iter_container_new(dict, 'e', NULL);
+        eldbus_message_iter_basic_append(entry, 's', e->id);
+        variant = eldbus_message_iter_container_new(entry, 'v', e->signature);
+
+        switch (*e->signature)
+          {
+           case 'a':
+              array = eldbus_message_iter_container_new(variant, 'a', "s");
+              EINA_LIST_FOREACH(e->value.list, node, str)
+                 eldbus_message_iter_basic_append(array, 's', str);
+              eldbus_message_iter_container_close(variant, array);
+              break;
+           case 's':
+              eldbus_message_iter_basic_append(variant, 's', e->value.s);
+              break;
+           case 'i':
+              eldbus_message_iter_basic_append(variant, 'i', e->value.i);
+              break;
+           case 'b':
+              eldbus_message_iter_basic_append(variant, 'b', e->value.b);
+              break;
+           default:
+              break;
+          }
+
+        eldbus_message_iter_container_close(entry, variant);
+        eldbus_message_iter_container_close(dict, entry);
+     }
+}
+
 static void
 _config_section_free(struct _config_section *base)
 {
    struct wkb_config_key *key;
    struct _config_section *sub;
+   struct _config_callback *callback;
 
    eina_stringshare_del(base->id);
 
+   eina_hash_free(base->keys_index);
+
    EINA_LIST_FREE(base->keys, key)
       wkb_config_key_free(key);
 
@@ -76,6 +185,10 @@ _config_section_free(struct _config_section *base)
 
    eina_list_free(base->subsections);
 
+   EINA_LIST_FREE(base->callbacks, callback)
+      free(callback);
+
+   free(base->values);
    free(base);
 }
 
@@ -111,64 +224,49 @@ _config_section_update(struct _config_section *base)
    return base->update(base) || ret;
 }
 
-static struct _config_section *
-_config_section_find(struct _config_section *base, const char *section)
+/*
+ * IBus clients use both 'preload-engines' and 'preload_engines' styles, and
+ * the engines use CamelCase, while the ids here are the struct field names.
+ * Lookups are done on a canonical form: lower case, '-' replaced by '_'.
+ */
+static const char *
+_config_string_canonical(const char *str, char *buf, size_t size)
 {
-   Eina_List *node;
-   struct _config_section *ret = NULL, *sub;
+   size_t i;
 
-   if (!section)
+   if (!str)
       return NULL;
 
-   if (base->id && !strncasecmp(section, base->id, strlen(section)))
+   for (i = 0; str[i] && i < size - 1; i++)
      {
-        DBG("Requested section: '%s' match: '%s'", section, base->id);
-        return base;
+        if (str[i] == '-')
+           buf[i] = '_';
+        else if (str[i] >= 'A' && str[i] <= 'Z')
+           buf[i] = str[i] + ('a' - 'A');
+        else
+           buf[i] = str[i];
      }
 
-   EINA_LIST_FOREACH(base->subsections, node, sub)
-      if ((ret = _config_section_find(sub, section)))
-         break;
-
-   return ret;
-}
-
-static struct _config_section *
-_config_section_toplevel(struct _config_section *base)
-{
-   while (base->parent != NULL)
-      base = base->parent;
+   if (str[i])
+     {
+        ERR("Config id '%s' too long", str);
+        return NULL;
+     }
 
-   return base;
+   buf[i] = '\0';
+   return buf;
 }
 
 static struct wkb_config_key *
-_config_section_find_key(struct _config_section *base, const char *section, const char *name)
+_config_section_find_key(struct _config_section *base, const char *name)
 {
-   struct wkb_config_key *ret = NULL, *key;
-   struct _config_section *sec;
-   const char *key_id;
-   Eina_List *node;
+   char buf[PATH_MAX];
+   const char *canonical;
 
-   if (!(sec = _config_section_find(base, section)))
-     {
-        DBG("Config section with id '%s' not found", section);
-        goto end;
-     }
-
-   EINA_LIST_FOREACH(sec->keys, node, key)
-     {
-        key_id = wkb_config_key_id(key);
-        if (!strcasecmp(name, key_id))
-          {
-             DBG("Requested key: '%s' match: '%s'", name, key_id);
-             ret = key;
-             break;
-          }
-     }
+   if (!base->keys_index || !(canonical = _config_string_canonical(name, buf, sizeof(buf))))
+      return NULL;
 
-end:
-   return ret;
+   return eina_hash_find(base->keys_index, canonical);
 }
 
 void
@@ -202,14 +300,15 @@ _config_section_dump(struct _config_section *base, const char *tab)
                 }
            case 'a':
                 {
-                   char **s, **slist = wkb_config_key_get_string_list(key);
+                   const Eina_List *l;
+                   const char *str;
+
                    printf("{");
-                   for (s = slist; *s != NULL; ++s)
+                   EINA_LIST_FOREACH(wkb_config_key_get_list(key), l, str)
                      {
-                        printf("'%s',", *s);
+                        printf("'%s',", str);
                      }
                    printf("}\n");
-                   free(slist);
                    break;
                 }
            default:
@@ -226,14 +325,15 @@ _config_section_dump(struct _config_section *base, const char *tab)
    eina_stringshare_del(new_tab);
 }
 
-#define _config_section_init(_section, _id, _parent) \
+#define _config_section_init_full(_section, _id, _parent, _edd, _keys) \
    do { \
         if (!_section) \
            break; \
         _section->set_defaults = _config_ ## _id ## _set_defaults; \
         _section->update = _config_ ## _id ## _update; \
         _section->parent = _parent; \
-        _section->edd = _ ## _id ## _edd; \
+        _section->edd = _edd; \
+        _section->keys_desc = _keys; \
         if (!_section->parent) \
            _section->id = eina_stringshare_add(#_id); \
         else \
@@ -248,24 +348,35 @@ _config_section_dump(struct _config_section *base, const char *tab)
         _config_ ## _id ## _section_init(_section); \
    } while (0)
 
-#define _config_section_add_key(_section, _section_id, _key_type, _field) \
-   do { \
-        struct _config_ ## _section_id *__conf = (struct _config_ ## _section_id *) _section; \
-        struct wkb_config_key *__key = wkb_config_key_ ## _key_type(#_field, _section->id, &__conf->_field); \
-        _section->keys = eina_list_append(_section->keys, __key); \
-   } while (0)
-
-#define _config_section_add_key_int(_section, _section_id, _field) \
-    _config_section_add_key(_section, _section_id, int, _field)
+/* Sections holding keys, stored in their own entry */
+#define _config_section_init(_section, _id, _parent) \
+   _config_section_init_full(_section, _id, _parent, _ ## _id ## _edd, _config_ ## _id ## _keys)
 
-#define _config_section_add_key_bool(_section, _section_id, _field) \
-    _config_section_add_key(_section, _section_id, bool, _field)
+/* Sections only holding subsections, with neither entry nor keys */
+#define _config_container_init(_section, _id, _parent) \
+   _config_section_init_full(_section, _id, _parent, NULL, NULL)
 
-#define _config_section_add_key_string(_section, _section_id, _field) \
-    _config_section_add_key(_section, _section_id, string, _field)
+/*
+ * Sections holding keys are generated from the GSettings schemas in
+ * data/schemas by wkb-ibus-config-gen.awk: the struct and a table with the
+ * name, field offset, type and default of each key, terminated by a NULL name.
+ */
+struct _config_key_desc
+{
+   const char *name; /* Eet element name, as in the schema */
+   const char *id; /* canonical id, also the struct field */
+   const char *signature;
+   size_t offset;
+   union
+     {
+        int i;
+        Eina_Bool b;
+        const char *s;
+        const char **list;
+     } value;
+};
 
-#define _config_section_add_key_string_list(_section, _section_id, _field) \
-    _config_section_add_key(_section, _section_id, string_list, _field)
+#include "wkb-ibus-config-sections.h"
 
 /*
  * Helpers
@@ -282,239 +393,162 @@ _config_string_list_new(const char **strs)
    return list;
 }
 
-static char *
-_config_string_sanitize(const char *str)
-{
-   char *s, *sane = strdup(str);
-
-   for (s = sane; *s; s++)
-     {
-        if (*s == '-')
-           *s = '_';
-        else if (*s >= 'A' && *s <= 'Z')
-           *s += ('a' - 'A');
-     }
-
-   return sane;
-}
-
-/*
- * <schema path="/desktop/ibus/general/hotkey/" id="org.freedesktop.ibus.general.hotkey">
- *   <key type="as" name="trigger">
- *     <default>[ 'Control+space', 'Zenkaku_Hankaku', 'Alt+Kanji', 'Alt+grave', 'Hangul', 'Alt+Release+Alt_R' ]</default>
- *     <summary>Trigger shortcut keys</summary>
- *     <description>The shortcut keys for turning input method on or off</description>
- *   </key>
- *   <key type="as" name="triggers">
- *     <default>[ '&lt;Super&gt;space' ]</default>
- *     <summary>Trigger shortcut keys for gtk_accelerator_parse</summary>
- *     <description>The shortcut keys for turning input method on or off</description>
- *   </key>
- *   <key type="as" name="enable-unconditional">
- *     <default>[]</default>
- *     <summary>Enable shortcut keys</summary>
- *     <description>The shortcut keys for turning input method on</description>
- *   </key>
- *   <key type="as" name="disable-unconditional">
- *     <default>[]</default>
- *     <summary>Disable shortcut keys</summary>
- *     <description>The shortcut keys for turning input method off</description>
- *   </key>
- *   <key type="as" name="next-engine">
- *     <default>[ 'Alt+Shift_L' ]</default>
- *     <summary>Next engine shortcut keys</summary>
- *     <description>The shortcut keys for switching to the next input method in the list</description>
- *   </key>
- *   <key type="as" name="next-engine-in-menu">
- *     <default>[ 'Alt+Shift_L' ]</default>
- *     <summary>Next engine shortcut keys</summary>
- *     <description>The shortcut keys for switching to the next input method in the list</description>
- *   </key>
- *   <key type="as" name="prev-engine">
- *     <default>[]</default>
- *     <summary>Prev engine shortcut keys</summary>
- *     <description>The shortcut keys for switching to the previous input method</description>
- *   </key>
- *   <key type="as" name="previous-engine">
- *     <default>[]</default>
- *     <summary>Prev engine shortcut keys</summary>
- *     <description>The shortcut keys for switching to the previous input method</description>
- *   </key>
- * </schema>
- */
-struct _config_hotkey
-{
-   struct _config_section base;
-
-   Eina_List *trigger;
-   Eina_List *triggers;
-   Eina_List *enable_unconditional;
-   Eina_List *disable_unconditional;
-   Eina_List *next_engine;
-   Eina_List *next_engine_in_menu;
-   Eina_List *prev_engine;
-   Eina_List *previous_engine;
-};
-
 static Eet_Data_Descriptor *
-_config_hotkey_edd_new(void)
+_config_keys_edd_new(const char *name, int size, const struct _config_key_desc *desc)
 {
    Eet_Data_Descriptor *edd;
    Eet_Data_Descriptor_Class eddc;
 
-   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_hotkey);
+   eet_eina_stream_data_descriptor_class_set(&eddc, sizeof(eddc), name, size);
    edd = eet_data_descriptor_stream_new(&eddc);
 
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_hotkey, "trigger", trigger);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_hotkey, "triggers", triggers);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_hotkey, "enable-unconditional", enable_unconditional);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_hotkey, "disable-unconditional", disable_unconditional);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_hotkey, "next-engine", next_engine);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_hotkey, "next-engine-in-menu", next_engine_in_menu);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_hotkey, "prev-engine", prev_engine);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_hotkey, "previous-engine", previous_engine);
+   for (; desc->name; desc++)
+     {
+        switch (*desc->signature)
+          {
+           case 'a':
+              eet_data_descriptor_element_add(edd, desc->name, EET_T_STRING, EET_G_LIST, desc->offset, 0, NULL, NULL);
+              break;
+           case 's':
+              eet_data_descriptor_element_add(edd, desc->name, EET_T_STRING, EET_G_UNKNOWN, desc->offset, 0, NULL, NULL);
+              break;
+           case 'i':
+              eet_data_descriptor_element_add(edd, desc->name, EET_T_INT, EET_G_UNKNOWN, desc->offset, 0, NULL, NULL);
+              break;
+           case 'b':
+              eet_data_descriptor_element_add(edd, desc->name, EET_T_UCHAR, EET_G_UNKNOWN, desc->offset, 0, NULL, NULL);
+              break;
+           default:
+              ERR("Unsupported signature '%s' for key '%s'", desc->signature, desc->name);
+              break;
+          }
+     }
 
    return edd;
 }
 
+/*
+ * Strings and lists are owned by the section, so the defaults are copied
+ * field by field rather than from a template struct.
+ */
 static void
-_config_hotkey_set_defaults(struct _config_section *base)
+_config_key_set_default(struct _config_section *base, const struct _config_key_desc *desc)
 {
-   struct _config_hotkey *hotkey = (struct _config_hotkey *) base;
+   void *field = (char *) base + desc->offset;
 
-   const char *trigger[] = { "Control+space", "Zenkaku_Hankaku", "Alt+Kanji", "Alt+grave", "Hangul", "Alt+Release+Alt_R", NULL };
-   const char *triggers[] = { "<Super>space", NULL };
-   const char *enable_unconditional[] = { NULL };
-   const char *disable_unconditional[] = { NULL };
-   const char *next_engine[] = { NULL };
-   const char *next_engine_in_menu[] = { NULL };
-   const char *prev_engine[] = { NULL };
-   const char *previous_engine[] = { NULL };
-
-   hotkey->trigger = _config_string_list_new(trigger);
-   hotkey->triggers = _config_string_list_new(triggers);
-   hotkey->enable_unconditional = _config_string_list_new(enable_unconditional);
-   hotkey->disable_unconditional = _config_string_list_new(disable_unconditional);
-   hotkey->next_engine = _config_string_list_new(next_engine);
-   hotkey->next_engine_in_menu = _config_string_list_new(next_engine_in_menu);
-   hotkey->prev_engine = _config_string_list_new(prev_engine);
-   hotkey->previous_engine = _config_string_list_new(previous_engine);
+   switch (*desc->signature)
+     {
+      case 'a':
+         *(Eina_List **) field = _config_string_list_new(desc->value.list);
+         break;
+      case 's':
+         *(const char **) field = eina_stringshare_add(desc->value.s);
+         break;
+      case 'i':
+         *(int *) field = desc->value.i;
+         break;
+      case 'b':
+         *(Eina_Bool *) field = desc->value.b;
+         break;
+      default:
+         break;
+     }
 }
 
-#define _config_hotkey_update NULL;
-
 static void
-_config_hotkey_section_init(struct _config_section *base)
+_config_keys_set_defaults(struct _config_section *base, const struct _config_key_desc *desc)
 {
-   _config_section_add_key_string_list(base, hotkey, trigger);
-   _config_section_add_key_string_list(base, hotkey, triggers);
-   _config_section_add_key_string_list(base, hotkey, enable_unconditional);
-   _config_section_add_key_string_list(base, hotkey, disable_unconditional);
-   _config_section_add_key_string_list(base, hotkey, next_engine);
-   _config_section_add_key_string_list(base, hotkey, next_engine_in_menu);
-   _config_section_add_key_string_list(base, hotkey, prev_engine);
-   _config_section_add_key_string_list(base, hotkey, previous_engine);
+   for (; desc->name; desc++)
+      _config_key_set_default(base, desc);
 }
 
-static struct _config_section *
-_config_hotkey_new(struct _config_section *parent)
+static void
+_config_keys_init(struct _config_section *base, const struct _config_key_desc *desc)
 {
-   struct _config_hotkey *conf = calloc(1, sizeof(*conf));
-   struct _config_section *base = (struct _config_section *) conf;
+   struct wkb_config_key *key;
 
-   _config_section_init(base, hotkey, parent);
-   return base;
-}
+   for (; desc->name; desc++)
+     {
+        void *field = (char *) base + desc->offset;
 
-/*
- * <schema path="/desktop/ibus/general/" id="org.freedesktop.ibus.general">
- *    <key type="as" name="preload-engines">
- *      <default>[]</default>
- *      <summary>Preload engines</summary>
- *      <description>Preload engines during ibus starts up</description>
- *    </key>
- *    <key type="as" name="engines-order">
- *      <default>[]</default>
- *      <summary>Engines order</summary>
- *      <description>Saved engines order in input method list</description>
- *    </key>
- *    <key type="i" name="switcher-delay-time">
- *      <default>400</default>
- *      <summary>Popup delay milliseconds for IME switcher window</summary>
- *      <description>Set popup delay milliseconds to show IME switcher window. The default is 400. 0 = Show the window immediately. 0 &lt; Delay milliseconds. 0 &gt; Do not show the
- *    </key>
- *    <key type="s" name="version">
- *      <default>''</default>
- *      <summary>Saved version number</summary>
- *      <description>The saved version number will be used to check the difference between the version of the previous installed ibus and one of the current ibus.</description>
- *    </key>
- *    <key type="b" name="use-system-keyboard-layout">
- *      <default>false</default>
- *      <summary>Use system keyboard layout</summary>
- *      <description>Use system keyboard (XKB) layout</description>
- *    </key>
- *    <key type="b" name="embed-preedit-text">
- *      <default>true</default>
- *      <summary>Embed Preedit Text</summary>
- *      <description>Embed Preedit Text in Application Window</description>
- *    </key>
- *    <key type="b" name="use-global-engine">
- *      <default>false</default>
- *      <summary>Use global input method</summary>
- *     <description>Share the same input method among all applications</description>
- *    </key>
- *    <key type="b" name="enable-by-default">
- *      <default>false</default>
- *      <summary>Enable input method by default</summary>
- *      <description>Enable input method by default when the application gets input focus</description>
- *    </key>
- *    <key type="as" name="dconf-preserve-name-prefixes">
- *      <default>[ '/desktop/ibus/engine/pinyin', '/desktop/ibus/engine/bopomofo', '/desktop/ibus/engine/hangul' ]</default>
- *      <summary>DConf preserve name prefixes</summary>
- *      <description>Prefixes of DConf keys to stop name conversion</description>
- *    </key>
- *    <child schema="org.freedesktop.ibus.general.hotkey" name="hotkey"/>
- * </schema>
- */
-struct _config_general
-{
-   struct _config_section base;
+        switch (*desc->signature)
+          {
+           case 'a':
+              key = wkb_config_key_string_list(desc->id, base->id, field);
+              break;
+           case 's':
+              key = wkb_config_key_string(desc->id, base->id, field);
+              break;
+           case 'i':
+              key = wkb_config_key_int(desc->id, base->id, field);
+              break;
+           case 'b':
+              key = wkb_config_key_bool(desc->id, base->id, field);
+              break;
+           default:
+              continue;
+          }
 
-   struct _config_section *hotkey;
+        base->keys = eina_list_append(base->keys, key);
 
-   Eina_List *preload_engines;
-   Eina_List *engines_order;
-   Eina_List *dconf_preserve_name_prefixes;
+        if (!base->keys_index)
+           base->keys_index = eina_hash_string_superfast_new(NULL);
 
-   const char *version;
+        eina_hash_add(base->keys_index, desc->id, key);
+     }
+}
 
-   int switcher_delay_time;
+/*
+ * Glue for sections with only keys, _config_<id>_update must be defined first
+ */
+#define _config_section_keys_define(_id) \
+   static Eet_Data_Descriptor * \
+   _config_ ## _id ## _edd_new(void) \
+   { \
+      return _config_keys_edd_new("struct _config_" #_id, sizeof(struct _config_ ## _id), _config_ ## _id ## _keys); \
+   } \
+   \
+   static void \
+   _config_ ## _id ## _set_defaults(struct _config_section *base) \
+   { \
+      _config_keys_set_defaults(base, _config_ ## _id ## _keys); \
+   } \
+   \
+   static void \
+   _config_ ## _id ## _section_init(struct _config_section *base) \
+   { \
+      _config_keys_init(base, _config_ ## _id ## _keys); \
+   } \
+   \
+   static struct _config_section * \
+   _config_ ## _id ## _new(struct _config_section *parent) \
+   { \
+      struct _config_ ## _id *conf = calloc(1, sizeof(*conf)); \
+      struct _config_section *base = (struct _config_section *) conf; \
+      \
+      _config_section_init(base, _id, parent); \
+      return base; \
+   }
 
-   Eina_Bool use_system_keyboard_layout;
-   Eina_Bool embed_preedit_text;
-   Eina_Bool use_global_engine;
-   Eina_Bool enable_by_default;
-};
+/*
+ * org.freedesktop.ibus.general.hotkey
+ */
+#define _config_hotkey_update NULL
 
+_config_section_keys_define(hotkey)
+
+/*
+ * org.freedesktop.ibus.general
+ */
 static Eet_Data_Descriptor *
 _config_general_edd_new(Eet_Data_Descriptor *hotkey_edd)
 {
    Eet_Data_Descriptor *edd;
-   Eet_Data_Descriptor_Class eddc;
 
-   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_general);
-   edd = eet_data_descriptor_stream_new(&eddc);
+   edd = _config_keys_edd_new("struct _config_general", sizeof(struct _config_general), _config_general_keys);
 
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_general, "preload-engines", preload_engines);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_general, "engines-order", engines_order);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_general, "switcher-delay-time", switcher_delay_time, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_general, "version", version, EET_T_STRING);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_general, "use-system-keyboard-layout", use_system_keyboard_layout, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_general, "embed-preedit-text", embed_preedit_text, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_general, "use-global-engine", use_global_engine, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_general, "enable-by-default", enable_by_default, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_general, "dconf-preserve-name-prefixes", dconf_preserve_name_prefixes);
-   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_general, "hotkey", hotkey, hotkey_edd);
+   if (hotkey_edd)
+      EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_general, "hotkey", hotkey, hotkey_edd);
 
    return edd;
 }
@@ -522,40 +556,31 @@ _config_general_edd_new(Eet_Data_Descriptor *hotkey_edd)
 static void
 _config_general_set_defaults(struct _config_section *base)
 {
-   struct _config_general *general = (struct _config_general *) base;
+   _config_keys_set_defaults(base, _config_general_keys);
+}
+
+static Eina_Bool
+_config_general_update(struct _config_section *base)
+{
+   struct _config_general *conf = (struct _config_general *) base;
 
-   const char *preload_engines[] = { NULL };
-   const char *engines_order[] = { NULL };
-   const char *dconf_preserve_name_prefixes[] = { "/desktop/ibus/engine/pinyin", "/desktop/ibus/engine/bopomofo", "/desktop/ibus/engine/hangul", NULL };
+   if (conf->hotkey)
+      return EINA_FALSE;
 
-   general->preload_engines = _config_string_list_new(preload_engines);
-   general->engines_order = _config_string_list_new(engines_order);
-   general->switcher_delay_time = 400;
-   general->version = eina_stringshare_add("");
-   general->use_system_keyboard_layout = EINA_FALSE;
-   general->embed_preedit_text = EINA_TRUE;
-   general->use_global_engine = EINA_FALSE;
-   general->enable_by_default = EINA_FALSE;
-   general->dconf_preserve_name_prefixes = _config_string_list_new(dconf_preserve_name_prefixes);
-}
+   INF("Updating 'general' section");
+
+   conf->hotkey = _config_hotkey_new(base);
+   _config_section_set_defaults(conf->hotkey);
 
-#define _config_general_update NULL;
+   return EINA_TRUE;
+}
 
 static void
 _config_general_section_init(struct _config_section *base)
 {
    struct _config_general *conf = (struct _config_general *) base;
 
-   _config_section_add_key_string_list(base, general, preload_engines);
-   _config_section_add_key_string_list(base, general, engines_order);
-   _config_section_add_key_int(base, general, switcher_delay_time);
-   _config_section_add_key_string(base, general, version);
-   _config_section_add_key_bool(base, general, use_system_keyboard_layout);
-   _config_section_add_key_bool(base, general, embed_preedit_text);
-   _config_section_add_key_bool(base, general, use_global_engine);
-   _config_section_add_key_bool(base, general, enable_by_default);
-   _config_section_add_key_string_list(base, general, dconf_preserve_name_prefixes);
-
+   _config_keys_init(base, _config_general_keys);
    _config_section_init(conf->hotkey, hotkey, base);
 }
 
@@ -571,938 +596,1183 @@ _config_general_new(struct _config_section *parent)
 }
 
 /*
- * <schema path="/desktop/ibus/panel/" id="org.freedesktop.ibus.panel">
- *    <key type="i" name="show">
- *      <default>0</default>
- *      <summary>Auto hide</summary>
- *      <description>The behavior of language panel. 0 = Embedded in menu, 1 = Auto hide, 2 = Always show</description>
- *    </key>
- *    <key type="i" name="x">
- *      <default>-1</default>
- *      <summary>Language panel position</summary>
- *    </key>
- *    <key type="i" name="y">
- *      <default>-1</default>
- *      <summary>Language panel position</summary>
- *    </key>
- *    <key type="i" name="lookup-table-orientation">
- *      <default>1</default>
- *      <summary>Orientation of lookup table</summary>
- *      <description>Orientation of lookup table. 0 = Horizontal, 1 = Vertical</description>
- *    </key>
- *    <key type="b" name="show-icon-on-systray">
- *      <default>true</default>
- *      <summary>Show icon on system tray</summary>
- *      <description>Show icon on system tray</description>
- *    </key>
- *    <key type="b" name="show-im-name">
- *      <default>false</default>
- *      <summary>Show input method name</summary>
- *      <description>Show input method name on language bar</description>
- *    </key>
- *    <key type="b" name="use-custom-font">
- *      <default>false</default>
- *      <summary>Use custom font</summary>
- *      <description>Use custom font name for language panel</description>
- *    </key>
- *    <key type="s" name="custom-font">
- *      <default>'Sans 10'</default>
- *      <summary>Custom font</summary>
- *      <description>Custom font name for language panel</description>
- *    </key>
- * </schema>
+ * org.freedesktop.ibus.panel
+ */
+#define _config_panel_update NULL
+
+_config_section_keys_define(panel)
+
+/*
+ * org.freedesktop.ibus.engine.{hangul,pinyin,bopomofo}
  */
-struct _config_panel
+#define _config_hangul_update NULL
+#define _config_pinyin_update NULL
+#define _config_bopomofo_update NULL
+
+_config_section_keys_define(hangul)
+_config_section_keys_define(pinyin)
+_config_section_keys_define(bopomofo)
+
+/*
+ * NO SCHEMA AVAILABLE. BASED ON THE SOURCE CODE
+ */
+struct _config_engine
 {
    struct _config_section base;
-
-   const char *custom_font;
-   int show;
-   int x;
-   int y;
-   int lookup_table_orientation;
-   Eina_Bool show_icon_in_systray;
-   Eina_Bool show_im_name;
-   Eina_Bool use_custom_font;
+   struct _config_section *hangul;
+   struct _config_section *pinyin;
+   struct _config_section *bopomofo;
 };
 
 static Eet_Data_Descriptor *
-_config_panel_edd_new(void)
+_config_engine_edd_new(Eet_Data_Descriptor *hangul_edd, Eet_Data_Descriptor *pinyin_edd, Eet_Data_Descriptor *bopomofo_edd)
 {
    Eet_Data_Descriptor *edd;
    Eet_Data_Descriptor_Class eddc;
 
-   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_panel);
+   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_engine);
    edd = eet_data_descriptor_stream_new(&eddc);
 
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_panel, "custom-font", custom_font, EET_T_STRING);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_panel, "show", show, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_panel, "x", x, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_panel, "y", y, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_panel, "lookup-table-orientation", lookup_table_orientation, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_panel, "show-icon-in-systray", show_icon_in_systray, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_panel, "show-im-name", show_im_name, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_panel, "use-custom-font", use_custom_font, EET_T_UCHAR);
+   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_engine, "Hangul", hangul, hangul_edd);
+   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_engine, "Pinyin", pinyin, pinyin_edd);
+   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_engine, "Bopomofo", bopomofo, bopomofo_edd);
+
    return edd;
 }
 
-static void
-_config_panel_set_defaults(struct _config_section *base)
-{
-   struct _config_panel *panel = (struct _config_panel *) base;
-
-   panel->custom_font = eina_stringshare_add("Sans 10");
-   panel->show = 0;
-   panel->x = -1;
-   panel->y = -1;
-   panel->lookup_table_orientation = 1;
-   panel->show_icon_in_systray = EINA_TRUE;
-   panel->show_im_name = EINA_FALSE;
-   panel->use_custom_font = EINA_FALSE;
-}
+#define _config_engine_set_defaults NULL;
 
-#define _config_panel_update NULL;
+/* Engine sections are loaded on demand, see _config_eet_engine_load() */
+#define _config_engine_update NULL;
 
 static void
-_config_panel_section_init(struct _config_section *base)
+_config_engine_section_init(struct _config_section *base)
 {
-   _config_section_add_key_string(base, panel, custom_font);
-   _config_section_add_key_int(base, panel, show);
-   _config_section_add_key_int(base, panel, x);
-   _config_section_add_key_int(base, panel, y);
-   _config_section_add_key_int(base, panel, lookup_table_orientation);
-   _config_section_add_key_bool(base, panel, show_icon_in_systray);
-   _config_section_add_key_bool(base, panel, show_im_name);
-   _config_section_add_key_bool(base, panel, use_custom_font);
+   struct _config_engine *conf = (struct _config_engine *) base;
+
+   _config_section_init(conf->hangul, hangul, base);
+   _config_section_init(conf->pinyin, pinyin, base);
+   _config_section_init(conf->bopomofo, bopomofo, base);
 }
 
 static struct _config_section *
-_config_panel_new(struct _config_section *parent)
+_config_engine_new(struct _config_section *parent)
 {
-   struct _config_panel *conf = calloc(1, sizeof(*conf));
+   struct _config_engine *conf = calloc(1, sizeof(*conf));
    struct _config_section *base = (struct _config_section *) conf;
 
-   _config_section_init(base, panel, parent);
+   _config_container_init(base, engine, parent);
+   conf->hangul = _config_hangul_new(base);
+   conf->pinyin = _config_pinyin_new(base);
+   conf->bopomofo = _config_bopomofo_new(base);
+
    return base;
 }
 
 /*
- * NO SCHEMA AVAILABLE. BASED ON THE SOURCE CODE
+ * <schema path="/desktop/ibus/" id="org.freedesktop.ibus">
+ *    <child schema="org.freedesktop.ibus.general" name="general"/>
+ *    <child schema="org.freedesktop.ibus.panel" name="panel"/>
+ * </schema>
  */
-struct _config_hangul
+struct _config_ibus
 {
    struct _config_section base;
 
-   const char *hangulkeyboard;
-   Eina_List *hanjakeys;
-   Eina_Bool wordcommit;
-   Eina_Bool autoreorder;
+   struct _config_section *general;
+   struct _config_section *panel;
+   struct _config_section *engine;
 };
 
 static Eet_Data_Descriptor *
-_config_hangul_edd_new(void)
+_config_ibus_edd_new(Eet_Data_Descriptor *general_edd, Eet_Data_Descriptor *panel_edd, Eet_Data_Descriptor *engine_edd)
 {
    Eet_Data_Descriptor *edd;
    Eet_Data_Descriptor_Class eddc;
 
-   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_hangul);
+   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_ibus);
    edd = eet_data_descriptor_stream_new(&eddc);
 
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_hangul, "HangulKeyboard", hangulkeyboard, EET_T_STRING);
-   EET_DATA_DESCRIPTOR_ADD_LIST_STRING(edd, struct _config_hangul, "HanjaKeys", hanjakeys);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_hangul, "WordCommit", wordcommit, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_hangul, "AutoReorder", autoreorder, EET_T_UCHAR);
+   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_ibus, "general", general, general_edd);
+   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_ibus, "panel", panel, panel_edd);
+   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_ibus, "engine", engine, engine_edd);
 
    return edd;
 }
 
-static void
-_config_hangul_set_defaults(struct _config_section *base)
+#define _config_ibus_set_defaults NULL;
+
+static Eina_Bool
+_config_ibus_update(struct _config_section *base)
 {
-   struct _config_hangul *hangul = (struct _config_hangul *) base;
-   const char *hanja_keys[] = { "Hangul_Hanja", "F9", NULL };
+   struct _config_ibus *conf = (struct _config_ibus *) base;
 
-   hangul->hangulkeyboard = eina_stringshare_add("2");
-   hangul->hanjakeys = _config_string_list_new(hanja_keys);
-   hangul->wordcommit = EINA_FALSE;
-   hangul->autoreorder = EINA_TRUE;
-}
+   if (conf->general && conf->panel && conf->engine)
+      return EINA_FALSE;
 
-#define _config_hangul_update NULL;
+   INF("Updating 'ibus' section");
 
-static void
-_config_hangul_section_init(struct _config_section *base)
-{
-   _config_section_add_key_string(base, hangul, hangulkeyboard);
-   _config_section_add_key_string_list(base, hangul, hanjakeys);
-   _config_section_add_key_bool(base, hangul, wordcommit);
-   _config_section_add_key_bool(base, hangul, autoreorder);
-}
+   if (!conf->general)
+     {
+        conf->general = _config_general_new(base);
+        _config_section_set_defaults(conf->general);
+     }
 
-static struct _config_section *
-_config_hangul_new(struct _config_section *parent)
-{
-   struct _config_hangul *conf = calloc(1, sizeof(*conf));
-   struct _config_section *base = (struct _config_section *) conf;
+   if (!conf->panel)
+     {
+        conf->panel = _config_panel_new(base);
+        _config_section_set_defaults(conf->panel);
+     }
 
-   _config_section_init(base, hangul, parent);
+   if (!conf->engine)
+     {
+        conf->engine = _config_engine_new(base);
+        _config_section_set_defaults(conf->engine);
+     }
+
+   return EINA_TRUE;
+}
+
+static void
+_config_ibus_section_init(struct _config_section *base)
+{
+   struct _config_ibus *conf = (struct _config_ibus *) base;
+
+   _config_section_init(conf->general, general, base);
+   _config_section_init(conf->panel, panel, base);
+   _config_container_init(conf->engine, engine, base);
+}
+
+static struct _config_section *
+_config_ibus_new(void)
+{
+   struct _config_ibus *conf = calloc(1, sizeof(*conf));
+   struct _config_section *base = (struct _config_section *) conf;
+
+   _config_container_init(base, ibus, NULL);
+   conf->general = _config_general_new(base);
+   conf->panel = _config_panel_new(base);
+   conf->engine = _config_engine_new(base);
    return base;
 }
 
 /*
- * NO SCHEMA AVAILABLE. BASED ON THE SOURCE CODE
+ * org.weekeyboard
  */
-struct _config_pinyin
-{
-   struct _config_section base;
+#define _config_weekeyboard_update NULL
+
+_config_section_keys_define(weekeyboard)
+
+/*
+ * MAIN
+ */
+/*
+ * Sections changed by SetValue are only marked dirty. They are committed
+ * after WKB_CONFIG_EET_FLUSH_DELAY seconds without further changes, or at
+ * most WKB_CONFIG_EET_FLUSH_DELAY_MAX seconds after the first change, so a
+ * burst of changes costs a single commit.
+ *
+ * The config file is only ever read. A commit writes a complete side file,
+ * syncs it and renames it over the config file, so a crash leaves either the
+ * old or the new file, never a truncated one. The writing, syncing and
+ * renaming run in a thread.
+ */
+#define WKB_CONFIG_EET_FLUSH_DELAY 1.0
+#define WKB_CONFIG_EET_FLUSH_DELAY_MAX 10.0
 
-   Eina_Bool   autocommit;
-   Eina_Bool   commaperiodpage;
-   Eina_Bool   correctpinyin;
-   Eina_Bool   correctpinyin_gn_ng;
-   Eina_Bool   correctpinyin_iou_iu;
-   Eina_Bool   correctpinyin_mg_ng;
-   Eina_Bool   correctpinyin_on_ong;
-   Eina_Bool   correctpinyin_uei_ui;
-   Eina_Bool   correctpinyin_uen_un;
-   Eina_Bool   correctpinyin_ue_ve;
-   Eina_Bool   correctpinyin_v_u;
-   Eina_Bool   ctrlswitch;
-   const char *dictionaries;
-   Eina_Bool   doublepinyin;
-   int         doublepinyinschema;
-   Eina_Bool   dynamicadjust;
-   Eina_Bool   fuzzypinyin;
-   Eina_Bool   fuzzypinyin_an_ang;
-   Eina_Bool   fuzzypinyin_ang_an;
-   Eina_Bool   fuzzypinyin_c_ch;
-   Eina_Bool   fuzzypinyin_ch_c;
-   Eina_Bool   fuzzypinyin_en_eng;
-   Eina_Bool   fuzzypinyin_eng_en;
-   Eina_Bool   fuzzypinyin_f_h;
-   Eina_Bool   fuzzypinyin_g_k;
-   Eina_Bool   fuzzypinyin_h_f;
-   Eina_Bool   fuzzypinyin_ing_in;
-   Eina_Bool   fuzzypinyin_in_ing;
-   Eina_Bool   fuzzypinyin_k_g;
-   Eina_Bool   fuzzypinyin_l_n;
-   Eina_Bool   fuzzypinyin_l_r;
-   Eina_Bool   fuzzypinyin_n_l;
-   Eina_Bool   fuzzypinyin_r_l;
-   Eina_Bool   fuzzypinyin_sh_s;
-   Eina_Bool   fuzzypinyin_s_sh;
-   Eina_Bool   fuzzypinyin_zh_z;
-   Eina_Bool   fuzzypinyin_z_zh;
-   Eina_Bool   incompletepinyin;
-   Eina_Bool   initchinese;
-   Eina_Bool   initfull;
-   Eina_Bool   initfullpunct;
-   Eina_Bool   initsimplifiedchinese;
-   int         lookuptableorientation;
-   int         lookuptablepagesize;
-   Eina_Bool   minusequalpage;
-   Eina_Bool   shiftselectcandidate;
-   Eina_Bool   specialphrases;
+/*
+ * Schema version of the file, kept in its 'version' entry, files without one
+ * are version 0. Bump it whenever the schemas gain keys or sections, along
+ * with a step in _config_eet_migrations.
+ */
+#define WKB_CONFIG_EET_VERSION 1
+#define WKB_CONFIG_EET_VERSION_ENTRY "version"
+
+struct _config_eet_flush
+{
+   struct wkb_ibus_config_eet *config_eet;
+   const char *path;
+   const char *side_path;
+   Eet_File *file; /* side file */
+   Eina_List *sections; /* written to the side file */
+   unsigned int version; /* recorded in the side file */
+   const char *failed; /* id of the first section that could not be written */
+   Eina_Thread thread;
+   Eet_Error error;
 };
 
-static Eet_Data_Descriptor *
-_config_pinyin_edd_new(void)
+struct _config_eet_backend;
+
+struct wkb_ibus_config_eet
 {
-   Eet_Data_Descriptor *edd;
-   Eet_Data_Descriptor_Class eddc;
+   const struct _config_eet_backend *backend;
+   const char *path;
+   const char *side_path;
+   Eldbus_Service_Interface *iface;
+   Eina_List *sections;
+   Eina_Hash *sections_index; /* canonical section id -> struct _config_section */
+   Eet_File *file;
+   unsigned int version; /* of file */
 
-   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_pinyin);
-   edd = eet_data_descriptor_stream_new(&eddc);
+   Eina_List *dirty;
+   double dirty_since;
+   Ecore_Timer *flush_timer;
+   struct _config_eet_flush *flush;
+   struct wkb_ibus_config_eet_stats stats;
 
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "AutoCommit", autocommit, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CommaPeriodPage", commaperiodpage, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CorrectPinyin", correctpinyin, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CorrectPinyin_GN_NG", correctpinyin_gn_ng, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CorrectPinyin_IOU_IU", correctpinyin_iou_iu, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CorrectPinyin_MG_NG", correctpinyin_mg_ng, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CorrectPinyin_ON_ONG", correctpinyin_on_ong, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CorrectPinyin_UEI_UI", correctpinyin_uei_ui, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CorrectPinyin_UEN_UN", correctpinyin_uen_un, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CorrectPinyin_UE_VE", correctpinyin_ue_ve, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CorrectPinyin_V_U", correctpinyin_v_u, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "CtrlSwitch", ctrlswitch, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "Dictionaries", dictionaries, EET_T_STRING);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "DoublePinyin", doublepinyin, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "DoublePinyinSchema", doublepinyinschema, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "DynamicAdjust", dynamicadjust, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin", fuzzypinyin, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_AN_ANG", fuzzypinyin_an_ang, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_ANG_AN", fuzzypinyin_ang_an, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_C_CH", fuzzypinyin_c_ch, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_CH_C", fuzzypinyin_ch_c, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_EN_ENG", fuzzypinyin_en_eng, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_ENG_EN", fuzzypinyin_eng_en, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_F_H", fuzzypinyin_f_h, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_G_K", fuzzypinyin_g_k, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_H_F", fuzzypinyin_h_f, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_ING_IN", fuzzypinyin_ing_in, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_IN_ING", fuzzypinyin_in_ing, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_K_G", fuzzypinyin_k_g, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_L_N", fuzzypinyin_l_n, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_L_R", fuzzypinyin_l_r, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_N_L", fuzzypinyin_n_l, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_R_L", fuzzypinyin_r_l, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_SH_S", fuzzypinyin_sh_s, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_S_SH", fuzzypinyin_s_sh, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_ZH_Z", fuzzypinyin_zh_z, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "FuzzyPinyin_Z_ZH", fuzzypinyin_z_zh, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "IncompletePinyin", incompletepinyin, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "InitChinese", initchinese, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "InitFull", initfull, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "InitFullPunct", initfullpunct, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "InitSimplifiedChinese", initsimplifiedchinese, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "LookupTableOrientation", lookuptableorientation, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "LookupTablePageSize", lookuptablepagesize, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "MinusEqualPage", minusequalpage, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "ShiftSelectCandidate", shiftselectcandidate, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_pinyin, "SpecialPhrases", specialphrases, EET_T_UCHAR);
+   Eina_List *changed;
+   Ecore_Job *changed_job;
+   unsigned int section_callbacks;
 
-   return edd;
-}
+   struct wkb_ibus_config_shm *shm;
+};
 
 static void
-_config_pinyin_set_defaults(struct _config_section *base)
-{
-   struct _config_pinyin *pinyin = (struct _config_pinyin *) base;
-
-   pinyin->autocommit = EINA_FALSE;
-   pinyin->commaperiodpage = EINA_TRUE;
-   pinyin->correctpinyin = EINA_TRUE;
-   pinyin->correctpinyin_gn_ng = EINA_TRUE;
-   pinyin->correctpinyin_iou_iu = EINA_TRUE;
-   pinyin->correctpinyin_mg_ng = EINA_TRUE;
-   pinyin->correctpinyin_on_ong = EINA_TRUE;
-   pinyin->correctpinyin_uei_ui = EINA_TRUE;
-   pinyin->correctpinyin_uen_un = EINA_TRUE;
-   pinyin->correctpinyin_ue_ve = EINA_TRUE;
-   pinyin->correctpinyin_v_u = EINA_TRUE;
-   pinyin->ctrlswitch = EINA_FALSE;
-   pinyin->dictionaries = eina_stringshare_add("2");
-   pinyin->doublepinyin = EINA_FALSE;
-   pinyin->doublepinyinschema = 0;
-   pinyin->dynamicadjust = EINA_TRUE;
-   pinyin->fuzzypinyin = EINA_FALSE;
-   pinyin->fuzzypinyin_an_ang = EINA_TRUE;
-   pinyin->fuzzypinyin_ang_an = EINA_TRUE;
-   pinyin->fuzzypinyin_c_ch = EINA_TRUE;
-   pinyin->fuzzypinyin_ch_c = EINA_FALSE;
-   pinyin->fuzzypinyin_en_eng = EINA_TRUE;
-   pinyin->fuzzypinyin_eng_en = EINA_TRUE;
-   pinyin->fuzzypinyin_f_h = EINA_TRUE;
-   pinyin->fuzzypinyin_g_k = EINA_FALSE;
-   pinyin->fuzzypinyin_h_f = EINA_FALSE;
-   pinyin->fuzzypinyin_ing_in = EINA_TRUE;
-   pinyin->fuzzypinyin_in_ing = EINA_TRUE;
-   pinyin->fuzzypinyin_k_g = EINA_TRUE;
-   pinyin->fuzzypinyin_l_n = EINA_TRUE;
-   pinyin->fuzzypinyin_l_r = EINA_FALSE;
-   pinyin->fuzzypinyin_n_l = EINA_FALSE;
-   pinyin->fuzzypinyin_r_l = EINA_FALSE;
-   pinyin->fuzzypinyin_sh_s = EINA_FALSE;
-   pinyin->fuzzypinyin_s_sh = EINA_TRUE;
-   pinyin->fuzzypinyin_zh_z = EINA_FALSE;
-   pinyin->fuzzypinyin_z_zh = EINA_TRUE;
-   pinyin->incompletepinyin = EINA_TRUE;
-   pinyin->initchinese = EINA_TRUE;
-   pinyin->initfull = EINA_FALSE;
-   pinyin->initfullpunct = EINA_TRUE;
-   pinyin->initsimplifiedchinese = EINA_TRUE;
-   pinyin->lookuptableorientation = 0;
-   pinyin->lookuptablepagesize = 5;
-   pinyin->minusequalpage = EINA_TRUE;
-   pinyin->shiftselectcandidate = EINA_FALSE;
-   pinyin->specialphrases = EINA_TRUE;
-}
-
-#define _config_pinyin_update NULL;
+_config_eet_section_index(struct wkb_ibus_config_eet *config_eet, struct _config_section *base)
+{
+   struct _config_section *sub;
+   Eina_List *node;
+   char buf[PATH_MAX];
+   const char *canonical;
+
+   if ((canonical = _config_string_canonical(base->id, buf, sizeof(buf))))
+      eina_hash_set(config_eet->sections_index, canonical, base);
+
+   EINA_LIST_FOREACH(base->subsections, node, sub)
+      _config_eet_section_index(config_eet, sub);
+}
 
 static void
-_config_pinyin_section_init(struct _config_section *base)
-{
-   _config_section_add_key_bool(base, pinyin, autocommit);
-   _config_section_add_key_bool(base, pinyin, commaperiodpage);
-   _config_section_add_key_bool(base, pinyin, correctpinyin);
-   _config_section_add_key_bool(base, pinyin, correctpinyin_gn_ng);
-   _config_section_add_key_bool(base, pinyin, correctpinyin_iou_iu);
-   _config_section_add_key_bool(base, pinyin, correctpinyin_mg_ng);
-   _config_section_add_key_bool(base, pinyin, correctpinyin_on_ong);
-   _config_section_add_key_bool(base, pinyin, correctpinyin_uei_ui);
-   _config_section_add_key_bool(base, pinyin, correctpinyin_uen_un);
-   _config_section_add_key_bool(base, pinyin, correctpinyin_ue_ve);
-   _config_section_add_key_bool(base, pinyin, correctpinyin_v_u);
-   _config_section_add_key_bool(base, pinyin, ctrlswitch);
-   _config_section_add_key_string(base, pinyin, dictionaries);
-   _config_section_add_key_bool(base, pinyin, doublepinyin);
-   _config_section_add_key_int(base, pinyin, doublepinyinschema);
-   _config_section_add_key_bool(base, pinyin, dynamicadjust);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_an_ang);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_ang_an);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_c_ch);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_ch_c);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_en_eng);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_eng_en);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_f_h);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_g_k);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_h_f);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_ing_in);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_in_ing);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_k_g);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_l_n);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_l_r);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_n_l);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_r_l);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_sh_s);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_s_sh);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_zh_z);
-   _config_section_add_key_bool(base, pinyin, fuzzypinyin_z_zh);
-   _config_section_add_key_bool(base, pinyin, incompletepinyin);
-   _config_section_add_key_bool(base, pinyin, initchinese);
-   _config_section_add_key_bool(base, pinyin, initfull);
-   _config_section_add_key_bool(base, pinyin, initfullpunct);
-   _config_section_add_key_bool(base, pinyin, initsimplifiedchinese);
-   _config_section_add_key_int(base, pinyin, lookuptableorientation);
-   _config_section_add_key_int(base, pinyin, lookuptablepagesize);
-   _config_section_add_key_bool(base, pinyin, minusequalpage);
-   _config_section_add_key_bool(base, pinyin, shiftselectcandidate);
-   _config_section_add_key_bool(base, pinyin, specialphrases);
+_config_eet_section_add(struct wkb_ibus_config_eet *config_eet, struct _config_section *base)
+{
+   config_eet->sections = eina_list_append(config_eet->sections, base);
+   _config_eet_section_index(config_eet, base);
 }
 
-static struct _config_section *
-_config_pinyin_new(struct _config_section *parent)
+static void
+_config_eet_value_changed_emit(struct wkb_ibus_config_eet *config_eet, struct wkb_config_key *key)
 {
-   struct _config_pinyin *conf = calloc(1, sizeof(*conf));
-   struct _config_section *base = (struct _config_section *) conf;
+   Eldbus_Message *signal;
+   Eldbus_Message_Iter *iter;
 
-   _config_section_init(base, pinyin, parent);
-   return base;
+   /* Not connected to IBus at the moment */
+   if (!config_eet->iface)
+      return;
+
+   signal = eldbus_service_signal_new(config_eet->iface, 0);
+   iter = eldbus_message_iter_get(signal);
+   eldbus_message_iter_arguments_append(iter, "ss", wkb_config_key_section(key), wkb_config_key_id(key));
+   wkb_config_key_get(key, iter);
+
+   eldbus_service_signal_send(config_eet->iface, signal);
 }
 
 /*
- * NO SCHEMA AVAILABLE. BASED ON THE SOURCE CODE
+ * Key subscribers are reached through the key itself, section subscribers
+ * cost a single lookup, and only while there are any.
  */
-struct _config_bopomofo
+static void
+_config_eet_value_changed_notify(struct wkb_ibus_config_eet *config_eet, struct wkb_config_key *key)
 {
-   struct _config_section base;
+   union wkb_config_value value;
+   struct _config_section *sec;
+   struct _config_callback *callback;
+   Eina_List *node, *next;
 
-   int         auxiliaryselectkey_f;
-   int         auxiliaryselectkey_kp;
-   int         bopomofokeyboardmapping;
-   Eina_Bool   ctrlswitch;
-   const char *dictionaries;
-   Eina_Bool   dynamicadjust;
-   Eina_Bool   enterkey;
-   Eina_Bool   fuzzypinyin;
-   Eina_Bool   fuzzypinyin_an_ang;
-   Eina_Bool   fuzzypinyin_ang_an;
-   Eina_Bool   fuzzypinyin_c_ch;
-   Eina_Bool   fuzzypinyin_ch_c;
-   Eina_Bool   fuzzypinyin_en_eng;
-   Eina_Bool   fuzzypinyin_eng_en;
-   Eina_Bool   fuzzypinyin_f_h;
-   Eina_Bool   fuzzypinyin_g_k;
-   Eina_Bool   fuzzypinyin_h_f;
-   Eina_Bool   fuzzypinyin_ing_in;
-   Eina_Bool   fuzzypinyin_in_ing;
-   Eina_Bool   fuzzypinyin_k_g;
-   Eina_Bool   fuzzypinyin_l_n;
-   Eina_Bool   fuzzypinyin_l_r;
-   Eina_Bool   fuzzypinyin_n_l;
-   Eina_Bool   fuzzypinyin_r_l;
-   Eina_Bool   fuzzypinyin_sh_s;
-   Eina_Bool   fuzzypinyin_s_sh;
-   Eina_Bool   fuzzypinyin_zh_z;
-   Eina_Bool   fuzzypinyin_z_zh;
-   int         guidekey;
-   Eina_Bool   incompletepinyin;
-   Eina_Bool   initchinese;
-   Eina_Bool   initfull;
-   Eina_Bool   initfullpunct;
-   Eina_Bool   initsimplifiedchinese;
-   int         lookuptableorientation;
-   int         lookuptablepagesize;
-   int         selectkeys;
-   Eina_Bool   specialphrases;
-};
+   wkb_config_key_value_get(key, &value);
+   wkb_config_key_changed(key, &value);
 
-static Eet_Data_Descriptor *
-_config_bopomofo_edd_new(void)
+   if (!config_eet->section_callbacks)
+      return;
+
+   /* section ids are already canonical */
+   if (!(sec = eina_hash_find(config_eet->sections_index, wkb_config_key_section(key))))
+      return;
+
+   EINA_LIST_FOREACH_SAFE(sec->callbacks, node, next, callback)
+      callback->cb((void *) callback->data, key, &value);
+}
+
+static void
+_config_eet_publish_section(struct wkb_ibus_config_eet *config_eet, struct _config_section *base)
 {
-   Eet_Data_Descriptor *edd;
-   Eet_Data_Descriptor_Class eddc;
+   struct _config_section *sub;
+   struct wkb_config_key *key;
+   Eina_List *node;
 
-   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_bopomofo);
-   edd = eet_data_descriptor_stream_new(&eddc);
+   EINA_LIST_FOREACH(base->keys, node, key)
+      wkb_ibus_config_shm_add(config_eet->shm, key);
 
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "AuxiliarySelectKey_F", auxiliaryselectkey_f, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "AuxiliarySelectKey_KP", auxiliaryselectkey_kp, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "BopomofoKeyboardMapping", bopomofokeyboardmapping, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "CtrlSwitch", ctrlswitch, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "Dictionaries", dictionaries, EET_T_STRING);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "DynamicAdjust", dynamicadjust, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "EnterKey", enterkey, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin", fuzzypinyin, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_AN_ANG", fuzzypinyin_an_ang, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_ANG_AN", fuzzypinyin_ang_an, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_C_CH", fuzzypinyin_c_ch, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_CH_C", fuzzypinyin_ch_c, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_EN_ENG", fuzzypinyin_en_eng, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_ENG_EN", fuzzypinyin_eng_en, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_F_H", fuzzypinyin_f_h, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_G_K", fuzzypinyin_g_k, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_H_F", fuzzypinyin_h_f, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_ING_IN", fuzzypinyin_ing_in, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_IN_ING", fuzzypinyin_in_ing, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_K_G", fuzzypinyin_k_g, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_L_N", fuzzypinyin_l_n, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_L_R", fuzzypinyin_l_r, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_N_L", fuzzypinyin_n_l, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_R_L", fuzzypinyin_r_l, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_SH_S", fuzzypinyin_sh_s, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_S_SH", fuzzypinyin_s_sh, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_ZH_Z", fuzzypinyin_zh_z, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "FuzzyPinyin_Z_ZH", fuzzypinyin_z_zh, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "GuideKey", guidekey, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "IncompletePinyin", incompletepinyin, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "InitChinese", initchinese, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "InitFull", initfull, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "InitFullPunct", initfullpunct, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "InitSimplifiedChinese", initsimplifiedchinese, EET_T_UCHAR);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "LookupTableOrientation", lookuptableorientation, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "LookupTablePageSize", lookuptablepagesize, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "SelectKeys", selectkeys, EET_T_INT);
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_bopomofo, "SpecialPhrases", specialphrases, EET_T_UCHAR);
+   EINA_LIST_FOREACH(base->subsections, node, sub)
+      _config_eet_publish_section(config_eet, sub);
+}
 
-   return edd;
+static void
+_config_eet_publish(struct wkb_ibus_config_eet *config_eet)
+{
+   struct _config_section *sec;
+   Eina_List *node;
+
+   wkb_ibus_config_shm_begin(config_eet->shm);
+
+   EINA_LIST_FOREACH(config_eet->sections, node, sec)
+      _config_eet_publish_section(config_eet, sec);
+
+   wkb_ibus_config_shm_end(config_eet->shm);
 }
 
 static void
-_config_bopomofo_set_defaults(struct _config_section *base)
-{
-   struct _config_bopomofo *bopomofo = (struct _config_bopomofo *) base;
-
-   bopomofo->auxiliaryselectkey_f = 1;
-   bopomofo->auxiliaryselectkey_kp = 1;
-   bopomofo->bopomofokeyboardmapping = 0;
-   bopomofo->ctrlswitch = EINA_FALSE;
-   bopomofo->dictionaries = eina_stringshare_add("2");
-   bopomofo->dynamicadjust = EINA_TRUE;
-   bopomofo->enterkey = EINA_TRUE;
-   bopomofo->fuzzypinyin = EINA_TRUE;
-   bopomofo->fuzzypinyin_an_ang = EINA_TRUE;
-   bopomofo->fuzzypinyin_ang_an = EINA_FALSE;
-   bopomofo->fuzzypinyin_c_ch = EINA_TRUE;
-   bopomofo->fuzzypinyin_ch_c = EINA_FALSE;
-   bopomofo->fuzzypinyin_en_eng = EINA_TRUE;
-   bopomofo->fuzzypinyin_eng_en = EINA_TRUE;
-   bopomofo->fuzzypinyin_f_h = EINA_TRUE;
-   bopomofo->fuzzypinyin_g_k = EINA_FALSE;
-   bopomofo->fuzzypinyin_h_f = EINA_FALSE;
-   bopomofo->fuzzypinyin_ing_in = EINA_TRUE;
-   bopomofo->fuzzypinyin_in_ing = EINA_TRUE;
-   bopomofo->fuzzypinyin_k_g = EINA_TRUE;
-   bopomofo->fuzzypinyin_l_n = EINA_TRUE;
-   bopomofo->fuzzypinyin_l_r = EINA_FALSE;
-   bopomofo->fuzzypinyin_n_l = EINA_FALSE;
-   bopomofo->fuzzypinyin_r_l = EINA_FALSE;
-   bopomofo->fuzzypinyin_sh_s = EINA_FALSE;
-   bopomofo->fuzzypinyin_s_sh = EINA_TRUE;
-   bopomofo->fuzzypinyin_zh_z = EINA_FALSE;
-   bopomofo->fuzzypinyin_z_zh = EINA_TRUE;
-   bopomofo->guidekey = 1;
-   bopomofo->incompletepinyin = EINA_FALSE;
-   bopomofo->initchinese = EINA_TRUE;
-   bopomofo->initfull = EINA_FALSE;
-   bopomofo->initfullpunct = EINA_TRUE;
-   bopomofo->initsimplifiedchinese = EINA_TRUE;
-   bopomofo->lookuptableorientation = 0;
-   bopomofo->lookuptablepagesize = 5;
-   bopomofo->selectkeys = 0;
-   bopomofo->specialphrases = EINA_TRUE;
-}
-
-#define _config_bopomofo_update NULL;
+_config_eet_value_changed_job(void *data)
+{
+   struct wkb_ibus_config_eet *config_eet = data;
+   struct wkb_config_key *key;
+
+   config_eet->changed_job = NULL;
+
+   /* The whole snapshot is rewritten, once for all keys changed */
+   if (config_eet->shm)
+      _config_eet_publish(config_eet);
+
+   EINA_LIST_FREE(config_eet->changed, key)
+     {
+        _config_eet_value_changed_emit(config_eet, key);
+        _config_eet_value_changed_notify(config_eet, key);
+     }
+}
 
+/*
+ * ValueChanged is sent once per key per main loop iteration, with the last
+ * value set, no matter how many times the key changed in between.
+ */
 static void
-_config_bopomofo_section_init(struct _config_section *base)
-{
-   _config_section_add_key_int(base, bopomofo, auxiliaryselectkey_f);
-   _config_section_add_key_int(base, bopomofo, auxiliaryselectkey_kp);
-   _config_section_add_key_int(base, bopomofo, bopomofokeyboardmapping);
-   _config_section_add_key_bool(base, bopomofo, ctrlswitch);
-   _config_section_add_key_string(base, bopomofo, dictionaries);
-   _config_section_add_key_bool(base, bopomofo, dynamicadjust);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_an_ang);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_ang_an);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_c_ch);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_ch_c);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_en_eng);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_eng_en);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_f_h);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_g_k);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_h_f);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_ing_in);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_in_ing);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_k_g);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_l_n);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_l_r);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_n_l);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_r_l);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_sh_s);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_s_sh);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_zh_z);
-   _config_section_add_key_bool(base, bopomofo, fuzzypinyin_z_zh);
-   _config_section_add_key_int(base, bopomofo, guidekey);
-   _config_section_add_key_bool(base, bopomofo, incompletepinyin);
-   _config_section_add_key_bool(base, bopomofo, initchinese);
-   _config_section_add_key_bool(base, bopomofo, initfull);
-   _config_section_add_key_bool(base, bopomofo, initfullpunct);
-   _config_section_add_key_bool(base, bopomofo, initsimplifiedchinese);
-   _config_section_add_key_int(base, bopomofo, lookuptableorientation);
-   _config_section_add_key_int(base, bopomofo, lookuptablepagesize);
-   _config_section_add_key_int(base, bopomofo, selectkeys);
-   _config_section_add_key_bool(base, bopomofo, specialphrases);
+_config_eet_value_changed(struct wkb_ibus_config_eet *config_eet, struct wkb_config_key *key)
+{
+   if (!eina_list_data_find(config_eet->changed, key))
+      config_eet->changed = eina_list_append(config_eet->changed, key);
+
+   if (!config_eet->changed_job)
+      config_eet->changed_job = ecore_job_add(_config_eet_value_changed_job, config_eet);
 }
 
+static struct _config_section *_config_eet_section_load(struct wkb_ibus_config_eet *config_eet, const char *canonical);
+
 static struct _config_section *
-_config_bopomofo_new(struct _config_section *parent)
+wkb_ibus_config_section_find(struct wkb_ibus_config_eet *config_eet, const char *section)
 {
-   struct _config_bopomofo *conf = calloc(1, sizeof(*conf));
-   struct _config_section *base = (struct _config_section *) conf;
+   struct _config_section *ret;
+   char buf[PATH_MAX];
+   const char *canonical;
 
-   _config_section_init(base, bopomofo, parent);
-   return base;
+   if (!(canonical = _config_string_canonical(section, buf, sizeof(buf))))
+      return NULL;
+
+   if (!(ret = eina_hash_find(config_eet->sections_index, canonical)))
+      ret = _config_eet_section_load(config_eet, canonical);
+
+   return ret;
+}
+
+struct wkb_config_key *
+wkb_ibus_config_eet_find_key(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name)
+{
+   struct _config_section *sec;
+
+   if (!(sec = wkb_ibus_config_section_find(config_eet, section)))
+     {
+        DBG("Config section with id '%s' not found", section);
+        return NULL;
+     }
+
+   return _config_section_find_key(sec, name);
+}
+
+Eina_Bool
+wkb_ibus_config_eet_callback_add(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name, wkb_config_key_changed_cb cb, const void *data)
+{
+   struct _config_section *sec;
+   struct wkb_config_key *key;
+   struct _config_callback *callback;
+
+   if (!(sec = wkb_ibus_config_section_find(config_eet, section)))
+     {
+        DBG("Config section with id '%s' not found", section);
+        return EINA_FALSE;
+     }
+
+   if (name)
+     {
+        if (!(key = _config_section_find_key(sec, name)))
+          {
+             DBG("Config key with id '%s' not found", name);
+             return EINA_FALSE;
+          }
+
+        wkb_config_key_callback_add(key, cb, data);
+        return EINA_TRUE;
+     }
+
+   callback = calloc(1, sizeof(*callback));
+   callback->cb = cb;
+   callback->data = data;
+   sec->callbacks = eina_list_append(sec->callbacks, callback);
+   config_eet->section_callbacks++;
+
+   return EINA_TRUE;
+}
+
+void
+wkb_ibus_config_eet_callback_del(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name, wkb_config_key_changed_cb cb, const void *data)
+{
+   struct _config_section *sec;
+   struct wkb_config_key *key;
+   struct _config_callback *callback;
+   Eina_List *node;
+
+   if (!(sec = wkb_ibus_config_section_find(config_eet, section)))
+      return;
+
+   if (name)
+     {
+        if ((key = _config_section_find_key(sec, name)))
+           wkb_config_key_callback_del(key, cb, data);
+
+        return;
+     }
+
+   EINA_LIST_FOREACH(sec->callbacks, node, callback)
+     {
+        if (callback->cb != cb || callback->data != data)
+           continue;
+
+        sec->callbacks = eina_list_remove_list(sec->callbacks, node);
+        config_eet->section_callbacks--;
+        free(callback);
+        return;
+     }
+}
+
+static Eina_Bool
+wkb_ibus_config_section_write(struct wkb_ibus_config_eet *config_eet, Eet_File *file, struct _config_section *section)
+{
+   if (!section->edd)
+      return EINA_TRUE;
+
+   if (!eet_data_write(file, section->edd, section->id, section, EINA_TRUE))
+     {
+        ERR("Error writing section '%s' to Eet file '%s'", section->id, config_eet->side_path);
+        return EINA_FALSE;
+     }
+
+   DBG("Wrote section '%s' to Eet file '%s'", section->id, config_eet->side_path);
+   return EINA_TRUE;
 }
 
 /*
- * NO SCHEMA AVAILABLE. BASED ON THE SOURCE CODE
+ * Backends only differ in where sections are read from and whether changes
+ * are committed back: the file backend reads the config file and commits
+ * to it, the image backend reads a read only Eet image, mapped by Eet, and
+ * the memory backend starts from the built in defaults. The last two keep
+ * changes in memory and never write.
  */
-struct _config_engine
+struct _config_eet_backend
 {
-   struct _config_section base;
-   struct _config_section *hangul;
-   struct _config_section *pinyin;
-   struct _config_section *bopomofo;
+   const char *name;
+   /* Sets config_eet->file, EINA_FALSE to start from the defaults */
+   Eina_Bool (*open)(struct wkb_ibus_config_eet *config_eet);
+   Eina_Bool writable;
 };
 
-static Eet_Data_Descriptor *
-_config_engine_edd_new(Eet_Data_Descriptor *hangul_edd, Eet_Data_Descriptor *pinyin_edd, Eet_Data_Descriptor *bopomofo_edd)
+static Eina_Bool
+_config_eet_file_open(struct wkb_ibus_config_eet *config_eet)
 {
-   Eet_Data_Descriptor *edd;
-   Eet_Data_Descriptor_Class eddc;
+   struct stat buf;
 
-   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_engine);
-   edd = eet_data_descriptor_stream_new(&eddc);
+   /* Left over by a commit interrupted before its rename */
+   unlink(config_eet->side_path);
 
-   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_engine, "Hangul", hangul, hangul_edd);
-   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_engine, "Pinyin", pinyin, pinyin_edd);
-   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_engine, "Bopomofo", bopomofo, bopomofo_edd);
+   if (stat(config_eet->path, &buf) != 0)
+      return EINA_FALSE;
 
-   return edd;
+   if (!(config_eet->file = eet_open(config_eet->path, EET_FILE_MODE_READ)))
+     {
+        ERR("Error opening Eet file '%s', using defaults", config_eet->path);
+        return EINA_FALSE;
+     }
+
+   return EINA_TRUE;
 }
 
-#define _config_engine_set_defaults NULL;
+static Eina_Bool
+_config_eet_image_open(struct wkb_ibus_config_eet *config_eet)
+{
+   if (!(config_eet->file = eet_open(config_eet->path, EET_FILE_MODE_READ)))
+     {
+        ERR("Error opening Eet image '%s', using defaults", config_eet->path);
+        return EINA_FALSE;
+     }
+
+   return EINA_TRUE;
+}
 
 static Eina_Bool
-_config_engine_update(struct _config_section *base)
+_config_eet_memory_open(struct wkb_ibus_config_eet *config_eet)
 {
-   struct _config_engine *conf = (struct _config_engine *) base;
+   return EINA_FALSE;
+}
+
+static const struct _config_eet_backend _config_eet_backends[] = {
+   [WKB_IBUS_CONFIG_EET_BACKEND_FILE] = { "file", _config_eet_file_open, EINA_TRUE },
+   [WKB_IBUS_CONFIG_EET_BACKEND_IMAGE] = { "image", _config_eet_image_open, EINA_FALSE },
+   [WKB_IBUS_CONFIG_EET_BACKEND_MEMORY] = { "memory", _config_eet_memory_open, EINA_FALSE },
+};
+
+/* Queue a section for the next commit, without scheduling it */
+static void
+_config_eet_section_mark(struct wkb_ibus_config_eet *config_eet, struct _config_section *section)
+{
+   if (!config_eet->backend->writable)
+      return;
+
+   if (!section->edd || eina_list_data_find(config_eet->dirty, section))
+      return;
+
+   config_eet->dirty = eina_list_append(config_eet->dirty, section);
+}
+
+static void
+_config_eet_section_mark_all(struct wkb_ibus_config_eet *config_eet, struct _config_section *base)
+{
+   struct _config_section *sub;
+   Eina_List *node;
+
+   _config_eet_section_mark(config_eet, base);
 
-   if (conf->pinyin && conf->bopomofo)
+   EINA_LIST_FOREACH(base->subsections, node, sub)
+      _config_eet_section_mark_all(config_eet, sub);
+}
+
+/* Sections created by the update functions have no entry yet */
+static void
+_config_eet_section_mark_missing(struct wkb_ibus_config_eet *config_eet, struct _config_section *base)
+{
+   struct _config_section *sub;
+   Eina_List *node;
+   char **entries;
+   int n = 0;
+
+   EINA_LIST_FOREACH(base->subsections, node, sub)
+      _config_eet_section_mark_missing(config_eet, sub);
+
+   if (!base->edd)
+      return;
+
+   if (config_eet->file && (entries = eet_list(config_eet->file, base->id, &n)))
+      free(entries);
+
+   if (!n)
+      _config_eet_section_mark(config_eet, base);
+}
+
+static Eina_Bool
+_config_eet_fsync(const char *path, int flags)
+{
+   int fd;
+   Eina_Bool ret;
+
+   if ((fd = open(path, flags)) < 0)
       return EINA_FALSE;
 
-   INF("Updating 'engine' section");
+   ret = (fsync(fd) == 0);
+   close(fd);
+
+   return ret;
+}
+
+/*
+ * Builds the side file: dirty sections are encoded again, every other entry
+ * is copied as is from the current file, except the legacy 'ibus' one, and
+ * the version is set to the current one.
+ */
+static Eina_Bool _config_eet_sections_loaded(struct wkb_ibus_config_eet *config_eet);
+
+static struct _config_eet_flush *
+_config_eet_commit_prepare(struct wkb_ibus_config_eet *config_eet)
+{
+   struct _config_eet_flush *flush;
+   struct _config_section *sec;
+   char version[16];
+   char **entries;
+   void *data;
+   int i, n = 0, size;
+
+   flush = calloc(1, sizeof(*flush));
+   flush->config_eet = config_eet;
+   flush->path = config_eet->path;
+   flush->side_path = config_eet->side_path;
+
+   if (!(flush->file = eet_open(config_eet->side_path, EET_FILE_MODE_WRITE)))
+     {
+        ERR("Error opening Eet file '%s'", config_eet->side_path);
+        free(flush);
+        return NULL;
+     }
+
+   EINA_LIST_FREE(config_eet->dirty, sec)
+     {
+        if (wkb_ibus_config_section_write(config_eet, flush->file, sec))
+           config_eet->stats.sections_written++;
+        else if (!flush->failed)
+           flush->failed = sec->id;
+
+        flush->sections = eina_list_append(flush->sections, sec);
+     }
+
+   /* Sections still in the file as they were are only migrated once loaded */
+   flush->version = _config_eet_sections_loaded(config_eet) ? WKB_CONFIG_EET_VERSION : config_eet->version;
+   snprintf(version, sizeof(version), "%u", flush->version);
+   eet_write(flush->file, WKB_CONFIG_EET_VERSION_ENTRY, version, strlen(version) + 1, EINA_FALSE);
+
+   if (!config_eet->file || !(entries = eet_list(config_eet->file, "*", &n)))
+      n = 0;
 
-   if (!conf->pinyin)
+   for (i = 0; i < n; i++)
      {
-        conf->pinyin = _config_pinyin_new(base);
-        _config_section_set_defaults(conf->pinyin);
+        if (strcmp(entries[i], "ibus") == 0 || strcmp(entries[i], WKB_CONFIG_EET_VERSION_ENTRY) == 0)
+           continue;
+
+        /* section ids are already canonical */
+        sec = eina_hash_find(config_eet->sections_index, entries[i]);
+        if (sec && eina_list_data_find(flush->sections, sec))
+           continue;
+
+        if (!(data = eet_read(config_eet->file, entries[i], &size)))
+          {
+             ERR("Error copying entry '%s' of Eet file '%s'", entries[i], config_eet->path);
+             continue;
+          }
+
+        eet_write(flush->file, entries[i], data, size, EINA_TRUE);
+        free(data);
      }
 
-   if (!conf->bopomofo)
+   if (n)
+      free(entries);
+
+   config_eet->stats.flushes++;
+
+   return flush;
+}
+
+/*
+ * Closing the side file writes it out, it then replaces the config file in
+ * a single rename. Safe to run in a thread, only touches the flush.
+ */
+static void
+_config_eet_commit_finish(struct _config_eet_flush *flush)
+{
+   char *dir, *slash;
+
+   flush->error = eet_close(flush->file);
+   flush->file = NULL;
+
+   /* The side file lacks a section, it must not replace the config file */
+   if (flush->failed && flush->error == EET_ERROR_NONE)
+      flush->error = EET_ERROR_WRITE_ERROR;
+
+   if (flush->error != EET_ERROR_NONE)
+      return;
+
+   if (!_config_eet_fsync(flush->side_path, O_RDONLY) || rename(flush->side_path, flush->path) != 0)
      {
-        conf->bopomofo = _config_bopomofo_new(base);
-        _config_section_set_defaults(conf->bopomofo);
+        flush->error = EET_ERROR_WRITE_ERROR;
+        return;
      }
 
+   /* Make the rename itself durable */
+   dir = strdup(flush->path);
+   if ((slash = strrchr(dir, '/')))
+     {
+        *slash = '\0';
+        _config_eet_fsync(slash == dir ? "/" : dir, O_RDONLY | O_DIRECTORY);
+     }
+   else
+     {
+        _config_eet_fsync(".", O_RDONLY | O_DIRECTORY);
+     }
+   free(dir);
+}
+
+static Eina_Bool
+_config_eet_commit_done(struct wkb_ibus_config_eet *config_eet, struct _config_eet_flush *flush)
+{
+   struct _config_section *sec;
+
+   if (flush->error != EET_ERROR_NONE)
+     {
+        if (flush->failed)
+           ERR("Error committing Eet file '%s': section '%s' could not be written", config_eet->path, flush->failed);
+        else
+           ERR("Error committing Eet file '%s': %d", config_eet->path, flush->error);
+        unlink(flush->side_path);
+
+        /* Retried with the next commit, see _config_eet_flush_retry() */
+        EINA_LIST_FREE(flush->sections, sec)
+           _config_eet_section_mark(config_eet, sec);
+
+        return EINA_FALSE;
+     }
+
+   DBG("Committed Eet file '%s'", config_eet->path);
+   eina_list_free(flush->sections);
+   flush->sections = NULL;
+   config_eet->version = flush->version;
+
+   /* The cached handle still maps the replaced file */
+   if (config_eet->file)
+      eet_close(config_eet->file);
+
+   eet_clearcache();
+
+   if (!(config_eet->file = eet_open(config_eet->path, EET_FILE_MODE_READ)))
+      ERR("Error opening Eet file '%s'", config_eet->path);
+
    return EINA_TRUE;
 }
 
+/* Also run when only the version is out of date, to record the migration */
 static void
-_config_engine_section_init(struct _config_section *base)
+_config_eet_commit(struct wkb_ibus_config_eet *config_eet)
 {
-   struct _config_engine *conf = (struct _config_engine *) base;
+   struct _config_eet_flush *flush;
 
-   _config_section_init(conf->hangul, hangul, base);
-   _config_section_init(conf->pinyin, pinyin, base);
-   _config_section_init(conf->bopomofo, bopomofo, base);
+   if (!config_eet->backend->writable)
+      return;
+
+   if (!config_eet->dirty &&
+       (config_eet->version >= WKB_CONFIG_EET_VERSION || !_config_eet_sections_loaded(config_eet)))
+      return;
+
+   if (!(flush = _config_eet_commit_prepare(config_eet)))
+      return;
+
+   _config_eet_commit_finish(flush);
+   _config_eet_commit_done(config_eet, flush);
+   free(flush);
 }
 
-static struct _config_section *
-_config_engine_new(struct _config_section *parent)
+static void _config_eet_flush_done(void *data);
+static Eina_Bool _config_eet_flush_timer_cb(void *data);
+
+/* A failed commit is tried again after the usual delay, not on the next change */
+static void
+_config_eet_flush_retry(struct wkb_ibus_config_eet *config_eet)
 {
-   struct _config_engine *conf = calloc(1, sizeof(*conf));
-   struct _config_section *base = (struct _config_section *) conf;
+   if (!config_eet->flush_timer)
+      config_eet->flush_timer = ecore_timer_add(WKB_CONFIG_EET_FLUSH_DELAY, _config_eet_flush_timer_cb, config_eet);
+}
 
-   _config_section_init(base, engine, parent);
-   conf->hangul = _config_hangul_new(base);
-   conf->pinyin = _config_pinyin_new(base);
-   conf->bopomofo = _config_bopomofo_new(base);
+static void *
+_config_eet_flush_thread(void *data, Eina_Thread thread)
+{
+   struct _config_eet_flush *flush = data;
 
-   return base;
+   _config_eet_commit_finish(flush);
+   ecore_main_loop_thread_safe_call_async(_config_eet_flush_done, flush);
+
+   return NULL;
 }
 
-/*
- * <schema path="/desktop/ibus/" id="org.freedesktop.ibus">
- *    <child schema="org.freedesktop.ibus.general" name="general"/>
- *    <child schema="org.freedesktop.ibus.panel" name="panel"/>
- * </schema>
- */
-struct _config_ibus
+static void
+_config_eet_flush(struct wkb_ibus_config_eet *config_eet)
 {
-   struct _config_section base;
+   struct _config_eet_flush *flush;
 
-   struct _config_section *general;
-   struct _config_section *panel;
-   struct _config_section *engine;
-};
+   /* Picked up again in _config_eet_flush_done() */
+   if (config_eet->flush)
+      return;
 
-static Eet_Data_Descriptor *
-_config_ibus_edd_new(Eet_Data_Descriptor *general_edd, Eet_Data_Descriptor *panel_edd, Eet_Data_Descriptor *engine_edd)
+   if (!config_eet->dirty || !(flush = _config_eet_commit_prepare(config_eet)))
+      return;
+
+   if (!eina_thread_create(&flush->thread, EINA_THREAD_BACKGROUND, -1, _config_eet_flush_thread, flush))
+     {
+        WRN("Error creating flush thread, committing Eet file '%s' now", config_eet->path);
+        _config_eet_commit_finish(flush);
+        if (!_config_eet_commit_done(config_eet, flush))
+           _config_eet_flush_retry(config_eet);
+        free(flush);
+        return;
+     }
+
+   config_eet->flush = flush;
+}
+
+static void
+_config_eet_flush_done(void *data)
 {
-   Eet_Data_Descriptor *edd;
-   Eet_Data_Descriptor_Class eddc;
+   struct _config_eet_flush *flush = data;
+   struct wkb_ibus_config_eet *config_eet = flush->config_eet;
 
-   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_ibus);
-   edd = eet_data_descriptor_stream_new(&eddc);
+   /* Already joined and completed by wkb_ibus_config_eet_free() */
+   if (!config_eet)
+      goto end;
 
-   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_ibus, "general", general, general_edd);
-   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_ibus, "panel", panel, panel_edd);
-   EET_DATA_DESCRIPTOR_ADD_SUB(edd, struct _config_ibus, "engine", engine, engine_edd);
+   eina_thread_join(flush->thread);
+   config_eet->flush = NULL;
 
-   return edd;
+   /* Changes made while the thread was running go right away, failures wait */
+   if (!_config_eet_commit_done(config_eet, flush))
+      _config_eet_flush_retry(config_eet);
+   else if (config_eet->dirty && !config_eet->flush_timer)
+      _config_eet_flush(config_eet);
+
+end:
+   eina_list_free(flush->sections);
+   free(flush);
 }
 
-#define _config_ibus_set_defaults NULL;
-#define _config_ibus_update NULL;
+static Eina_Bool
+_config_eet_flush_timer_cb(void *data)
+{
+   struct wkb_ibus_config_eet *config_eet = data;
+
+   config_eet->flush_timer = NULL;
+   _config_eet_flush(config_eet);
+
+   return ECORE_CALLBACK_CANCEL;
+}
 
 static void
-_config_ibus_section_init(struct _config_section *base)
+_config_eet_section_dirty(struct wkb_ibus_config_eet *config_eet, struct _config_section *section)
 {
-   struct _config_ibus *conf = (struct _config_ibus *) base;
+   double now = ecore_loop_time_get();
 
-   _config_section_init(conf->general, general, base);
-   _config_section_init(conf->panel, panel, base);
-   _config_section_init(conf->engine, engine, base);
+   /* A value changed, the GetValues snapshot is stale */
+   free(section->values);
+   section->values = NULL;
+
+   if (!config_eet->backend->writable)
+      return;
+
+   if (eina_list_data_find(config_eet->dirty, section))
+     {
+        config_eet->stats.writes_avoided++;
+     }
+   else
+     {
+        if (!config_eet->dirty)
+           config_eet->dirty_since = now;
+
+        config_eet->dirty = eina_list_append(config_eet->dirty, section);
+     }
+
+   if (!config_eet->flush_timer)
+     {
+        config_eet->flush_timer = ecore_timer_add(WKB_CONFIG_EET_FLUSH_DELAY, _config_eet_flush_timer_cb, config_eet);
+        return;
+     }
+
+   if (now - config_eet->dirty_since < WKB_CONFIG_EET_FLUSH_DELAY_MAX)
+      ecore_timer_reset(config_eet->flush_timer);
 }
 
-static struct _config_section *
-_config_ibus_new(void)
+#define wkb_ibus_config_section_read(_eet, _id) \
+   do { \
+        struct _config_section *sec = NULL; \
+        if (!(sec = eet_data_read(_eet->file, _ ## _id ## _edd, #_id))) \
+          { \
+             INF("Error reading section '%s' from Eet file '%s'. Adding.", #_id , _eet->path); \
+             sec = _config_ ## _id ## _new(NULL); \
+             _config_section_set_defaults(sec); \
+             _config_eet_section_add(_eet, sec); \
+             _config_eet_section_mark_all(_eet, sec); \
+          } \
+        else \
+          { \
+             DBG("Read section '%s' from Eet file '%s'", #_id , _eet->path); \
+             _config_section_init(sec, _id, NULL); \
+             if (_config_section_update(sec)) \
+                _config_eet_section_mark_missing(_eet, sec); \
+             _config_eet_section_add(_eet, sec); \
+          } \
+   } while (0)
+
+static void *
+_config_eet_entry_read(struct wkb_ibus_config_eet *config_eet, Eet_Data_Descriptor *edd, const char *id)
 {
-   struct _config_ibus *conf = calloc(1, sizeof(*conf));
-   struct _config_section *base = (struct _config_section *) conf;
+   void *ret;
 
-   _config_section_init(base, ibus, NULL);
-   conf->general = _config_general_new(base);
-   conf->panel = _config_panel_new(base);
-   conf->engine = _config_engine_new(base);
-   return base;
+   if (!config_eet->file)
+      return NULL;
+
+   if (!(ret = eet_data_read(config_eet->file, edd, id)))
+      INF("Error reading section '%s' from Eet file '%s'. Adding.", id, config_eet->path);
+   else
+      DBG("Read section '%s' from Eet file '%s'", id, config_eet->path);
+
+   return ret;
 }
 
 /*
- * Weekeyboard specific configuration
+ * Assembles the ibus tree from the per section entries, missing sections are
+ * left NULL and filled with defaults by the update functions. Engine sections
+ * are left in the file until first used.
  */
-struct _config_weekeyboard
+static struct _config_section *
+_config_eet_ibus_read(struct wkb_ibus_config_eet *config_eet)
 {
-   struct _config_section base;
-   const char *theme;
+   struct _config_ibus *ibus = calloc(1, sizeof(*ibus));
+   struct _config_engine *engine = calloc(1, sizeof(*engine));
+   struct _config_general *general;
+
+   if ((general = _config_eet_entry_read(config_eet, _general_edd, "general")))
+      general->hotkey = _config_eet_entry_read(config_eet, _hotkey_edd, "general/hotkey");
+
+   ibus->general = (struct _config_section *) general;
+   ibus->panel = _config_eet_entry_read(config_eet, _panel_edd, "panel");
+   ibus->engine = (struct _config_section *) engine;
+
+   return (struct _config_section *) ibus;
+}
+
+static void _config_eet_section_migrate(struct wkb_ibus_config_eet *config_eet, struct _config_section *section);
+
+#define _config_eet_engine_load(_eet, _id) \
+   do { \
+        struct _config_section *__base = eina_hash_find(_eet->sections_index, "engine"); \
+        struct _config_engine *__engine = (struct _config_engine *) __base; \
+        if (!__engine || __engine->_id) \
+           break; \
+        if ((__engine->_id = _config_eet_entry_read(_eet, _ ## _id ## _edd, "engine/" #_id))) \
+          { \
+             _config_section_init(__engine->_id, _id, __base); \
+             _config_eet_section_migrate(_eet, __engine->_id); \
+          } \
+        else \
+          { \
+             __engine->_id = _config_ ## _id ## _new(__base); \
+             _config_section_set_defaults(__engine->_id); \
+             _config_eet_section_dirty(_eet, __engine->_id); \
+          } \
+        _config_eet_section_index(_eet, __engine->_id); \
+   } while (0)
+
+static void
+_config_eet_hangul_load(struct wkb_ibus_config_eet *config_eet)
+{
+   _config_eet_engine_load(config_eet, hangul);
+}
+
+static void
+_config_eet_pinyin_load(struct wkb_ibus_config_eet *config_eet)
+{
+   _config_eet_engine_load(config_eet, pinyin);
+}
+
+static void
+_config_eet_bopomofo_load(struct wkb_ibus_config_eet *config_eet)
+{
+   _config_eet_engine_load(config_eet, bopomofo);
+}
+
+static const struct
+{
+   const char *id;
+   void (*load)(struct wkb_ibus_config_eet *config_eet);
+} _config_eet_lazy_sections[] = {
+   { "engine/hangul", _config_eet_hangul_load },
+   { "engine/pinyin", _config_eet_pinyin_load },
+   { "engine/bopomofo", _config_eet_bopomofo_load },
+   { NULL, NULL },
 };
 
-static Eet_Data_Descriptor *
-_config_weekeyboard_edd_new(void)
+static struct _config_section *
+_config_eet_section_load(struct wkb_ibus_config_eet *config_eet, const char *canonical)
 {
-   Eet_Data_Descriptor *edd;
-   Eet_Data_Descriptor_Class eddc;
+   unsigned int i;
 
-   EET_EINA_STREAM_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct _config_weekeyboard);
-   edd = eet_data_descriptor_stream_new(&eddc);
+   for (i = 0; _config_eet_lazy_sections[i].id; i++)
+     {
+        if (strcmp(canonical, _config_eet_lazy_sections[i].id))
+           continue;
 
-   EET_DATA_DESCRIPTOR_ADD_BASIC(edd, struct _config_weekeyboard, "theme", theme, EET_T_STRING);
+        _config_eet_lazy_sections[i].load(config_eet);
+        return eina_hash_find(config_eet->sections_index, canonical);
+     }
 
-   return edd;
+   return NULL;
+}
+
+static void
+_config_eet_section_load_all(struct wkb_ibus_config_eet *config_eet)
+{
+   unsigned int i;
+
+   for (i = 0; _config_eet_lazy_sections[i].id; i++)
+      _config_eet_lazy_sections[i].load(config_eet);
+}
+
+static Eina_Bool
+_config_eet_sections_loaded(struct wkb_ibus_config_eet *config_eet)
+{
+   unsigned int i;
+
+   for (i = 0; _config_eet_lazy_sections[i].id; i++)
+      if (!eina_hash_find(config_eet->sections_index, _config_eet_lazy_sections[i].id))
+         return EINA_FALSE;
+
+   return EINA_TRUE;
 }
 
 static void
-_config_weekeyboard_set_defaults(struct _config_section *base)
+_config_eet_ibus_load(struct wkb_ibus_config_eet *config_eet)
 {
-   struct _config_weekeyboard *conf = (struct _config_weekeyboard *) base;
+   struct _config_section *sec;
+   Eina_Bool legacy = EINA_FALSE;
 
-   conf->theme = eina_stringshare_add("default");
-}
+   if ((sec = eet_data_read(config_eet->file, _ibus_legacy_edd, "ibus")))
+     {
+        INF("Migrating legacy 'ibus' section of Eet file '%s'", config_eet->path);
+        legacy = EINA_TRUE;
+     }
+   else
+     {
+        sec = _config_eet_ibus_read(config_eet);
+     }
 
-#define _config_weekeyboard_update NULL
+   _config_container_init(sec, ibus, NULL);
 
-static void
-_config_weekeyboard_section_init(struct _config_section *base)
-{
-   _config_section_add_key_string(base, weekeyboard, theme);
+   if (_config_section_update(sec) && !legacy)
+      _config_eet_section_mark_missing(config_eet, sec);
+
+   /* Every section moves to its own entry, the legacy one is dropped by the commit */
+   if (legacy)
+      _config_eet_section_mark_all(config_eet, sec);
+
+   _config_eet_section_add(config_eet, sec);
 }
 
-static struct _config_section *
-_config_weekeyboard_new(void)
+static unsigned int
+_config_eet_version_read(struct wkb_ibus_config_eet *config_eet)
 {
-   struct _config_weekeyboard *conf = calloc(1, sizeof(*conf));
-   struct _config_section *base = (struct _config_section *) conf;
+   unsigned int ret = 0;
+   char *data, *end;
+   int size;
 
-   _config_section_init(base, weekeyboard, NULL);
-   return base;
+   if (!config_eet->file || !(data = eet_read(config_eet->file, WKB_CONFIG_EET_VERSION_ENTRY, &size)))
+      return 0;
+
+   if (size > 0 && memchr(data, '\0', size))
+     {
+        ret = strtoul(data, &end, 10);
+        if (*end)
+           ret = 0;
+     }
+
+   free(data);
+   return ret;
 }
 
 /*
- * MAIN
+ * Keys are decoded to 0 or NULL when missing from an entry, the schema
+ * default is only known here. Each key is looked up by name in the encoded
+ * entry, the ones not found get their default and only their section is
+ * written again. Eet does not store empty lists, so a missing list cannot be
+ * told from one emptied by the user and is left alone.
  */
-struct wkb_ibus_config_eet
-{
-   const char *path;
-   Eldbus_Service_Interface *iface;
-   Eina_List *sections;
-   Eet_File *file;
-};
-
 static void
-_config_eet_value_changed(struct wkb_ibus_config_eet *config_eet, struct wkb_config_key *key)
+_config_eet_section_keys_add(struct wkb_ibus_config_eet *config_eet, struct _config_section *base)
 {
-   Eldbus_Message *signal;
-   Eldbus_Message_Iter *value, *iter;
-   const char *sig;
-
-   signal = eldbus_service_signal_new(config_eet->iface, 0);
-   iter = eldbus_message_iter_get(signal);
-   eldbus_message_iter_arguments_append(iter, "ss", wkb_config_key_section(key), wkb_config_key_id(key));
+   const struct _config_key_desc *desc;
+   struct _config_section *sub;
+   Eet_Node *root, *node;
+   Eina_List *l;
 
-   sig = wkb_config_key_signature(key);
-   switch (*sig)
-     {
-      case 's':
-           {
-              value = eldbus_message_iter_container_new(iter, 'v', sig);
-              eldbus_message_iter_basic_append(value, 's', wkb_config_key_get_string(key));
-              break;
-           }
-      case 'i':
-           {
-              value = eldbus_message_iter_container_new(iter, 'v', sig);
-              eldbus_message_iter_basic_append(value, 'i', wkb_config_key_get_int(key));
-              break;
-           }
-      case 'b':
-           {
-              value = eldbus_message_iter_container_new(iter, 'v', sig);
-              eldbus_message_iter_basic_append(value, 'b', wkb_config_key_get_bool(key));
-              break;
-           }
-      case 'a':
-           {
-              char **s, **slist = wkb_config_key_get_string_list(key);
-              Eldbus_Message_Iter *array;
+   EINA_LIST_FOREACH(base->subsections, l, sub)
+      _config_eet_section_keys_add(config_eet, sub);
 
-              value = eldbus_message_iter_container_new(iter, 'v', "as");
-              array = eldbus_message_iter_container_new(value, 'a', "s");
+   if (!base->edd || !base->keys_desc || !config_eet->file)
+      return;
 
-              for (s = slist; *s != NULL; ++s)
-                 eldbus_message_iter_arguments_append(array, "s", *s);
+   /* Sections without an entry were created with defaults */
+   if (!(root = eet_data_node_read_cipher(config_eet->file, base->id, NULL)))
+      return;
 
-              eldbus_message_iter_container_close(value, array);
+   for (desc = base->keys_desc; desc->name; desc++)
+     {
+        if (*desc->signature == 'a')
+           continue;
 
-              free(slist);
-              break;
-           }
-      default:
-           {
-              value = eldbus_message_iter_container_new(iter, 'v', NULL);
+        for (node = eet_node_children_get(root); node; node = eet_node_next_get(node))
+           if (strcmp(eet_node_name_get(node), desc->name) == 0)
               break;
-           }
+
+        if (node)
+           continue;
+
+        INF("Adding key '%s' to section '%s'", desc->name, base->id);
+        _config_key_set_default(base, desc);
+        _config_eet_section_mark(config_eet, base);
      }
 
-   eldbus_message_iter_container_close(iter, value);
-   eldbus_service_signal_send(config_eet->iface, signal);
+   eet_node_del(root);
 }
 
-struct wkb_config_key *
-wkb_ibus_config_eet_find_key(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name)
+/*
+ * Steps applied in order to the sections of files older than their version,
+ * as the sections are loaded. Sections and keys untouched by them are left
+ * as they are in the file. The file only records the new version once every
+ * section went through them, see _config_eet_commit_prepare().
+ */
+static const struct
+{
+   unsigned int version;
+   const char *description;
+   void (*migrate)(struct wkb_ibus_config_eet *config_eet, struct _config_section *section);
+} _config_eet_migrations[] = {
+   { 1, "adding missing keys", _config_eet_section_keys_add },
+   { 0, NULL, NULL },
+};
+
+static void
+_config_eet_section_migrate(struct wkb_ibus_config_eet *config_eet, struct _config_section *section)
 {
-   struct wkb_config_key *key;
-   struct _config_section *sec;
-   Eina_List *node;
+   unsigned int i;
 
-   EINA_LIST_FOREACH(config_eet->sections, node, sec)
-      if ((key = _config_section_find_key(sec, section, name)))
-         return key;
+   for (i = 0; _config_eet_migrations[i].migrate; i++)
+     {
+        if (_config_eet_migrations[i].version <= config_eet->version)
+           continue;
 
-   return NULL;
+        DBG("Migrating section '%s' of Eet file '%s' to version %u: %s", section->id, config_eet->path,
+            _config_eet_migrations[i].version, _config_eet_migrations[i].description);
+        _config_eet_migrations[i].migrate(config_eet, section);
+     }
 }
 
-static struct _config_section *
-wkb_ibus_config_section_find(struct wkb_ibus_config_eet *config_eet, const char *section)
+/* Sections loaded on demand are migrated by _config_eet_engine_load() */
+static void
+_config_eet_migrate(struct wkb_ibus_config_eet *config_eet)
 {
-   struct _config_section *sec, *s;
+   struct _config_section *sec;
    Eina_List *node;
 
-   EINA_LIST_FOREACH(config_eet->sections, node, s)
-      if ((sec = _config_section_find(s, section)))
-         return sec;
-
-   return NULL;
-}
-
-static Eina_Bool
-wkb_ibus_config_section_write(struct wkb_ibus_config_eet *config_eet, struct _config_section *section)
-{
-   Eina_Bool ret = EINA_TRUE;
+   if (config_eet->version >= WKB_CONFIG_EET_VERSION)
+      return;
 
-   if (!eet_data_write(config_eet->file, section->edd, section->id, section, EINA_TRUE))
-     {
-        ERR("Error writing section '%s' to Eet file '%s'", section->id, config_eet->path);
-        ret = EINA_FALSE;
-     }
+   INF("Migrating Eet file '%s' from version %u to %u", config_eet->path,
+       config_eet->version, WKB_CONFIG_EET_VERSION);
 
-   DBG("Wrote section '%s' to Eet file '%s'", section->id, config_eet->path);
-   return ret;
+   EINA_LIST_FOREACH(config_eet->sections, node, sec)
+      _config_eet_section_migrate(config_eet, sec);
 }
 
-#define wkb_ibus_config_section_read(_eet, _id) \
-   do { \
-        struct _config_section *sec = NULL; \
-        if (!(sec = eet_data_read(_eet->file, _ ## _id ## _edd, #_id))) \
-          { \
-             INF("Error reading section '%s' from Eet file '%s'. Adding.", #_id , _eet->path); \
-             sec = _config_ ## _id ## _new(); \
-             _config_section_set_defaults(sec); \
-             _eet->sections = eina_list_append(_eet->sections, sec); \
-             wkb_ibus_config_section_write(_eet, sec); \
-          } \
-        else \
-          { \
-             DBG("Read section '%s' from Eet file '%s'", #_id , _eet->path); \
-             _config_section_init(sec, _id, NULL); \
-             if (_config_section_update(sec)) \
-                wkb_ibus_config_section_write(_eet, sec); \
-             _eet->sections = eina_list_append(_eet->sections, sec); \
-          } \
-   } while (0)
-
 Eina_Bool
 wkb_ibus_config_eet_set_value(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name, Eldbus_Message_Iter *value)
 {
-   Eina_Bool ret = EINA_FALSE;
+   Eina_Bool ret = EINA_FALSE, changed = EINA_FALSE;
    struct wkb_config_key *key;
-   struct _config_section *sec, *top;
+   struct _config_section *sec;
 
    if (!(sec = wkb_ibus_config_section_find(config_eet, section)))
      {
@@ -1510,25 +1780,127 @@ wkb_ibus_config_eet_set_value(struct wkb_ibus_config_eet *config_eet, const char
         goto end;
      }
 
-   if (!(key = _config_section_find_key(sec, section, name)))
+   if (!(key = _config_section_find_key(sec, name)))
      {
         ERR("Config key '%s' not found", name);
         goto end;
      }
 
-   if (!(ret = wkb_config_key_set(key, value)))
+   if (!(ret = wkb_config_key_set(key, value, &changed)))
      {
         ERR("Error setting new value for key '%s'", wkb_config_key_id(key));
         goto end;
      }
 
+   config_eet->stats.set_values++;
+
+   if (!changed)
+     {
+        DBG("Value of key '%s/%s' unchanged", section, name);
+        config_eet->stats.values_unchanged++;
+        goto end;
+     }
+
    _config_eet_value_changed(config_eet, key);
+   _config_eet_section_dirty(config_eet, sec);
+
+end:
+   return ret;
+}
+
+struct _config_eet_batch_entry
+{
+   struct _config_section *section;
+   struct wkb_config_key *key;
+   Eldbus_Message_Iter *value;
+};
+
+/*
+ * All entries are resolved and type checked before any of them is applied,
+ * so a bad entry leaves the config untouched. The batch ends with a single
+ * flush, ValueChanged signals are coalesced as for SetValue.
+ */
+Eina_Bool
+wkb_ibus_config_eet_set_values(struct wkb_ibus_config_eet *config_eet, Eldbus_Message_Iter *values)
+{
+   Eina_Bool ret = EINA_FALSE, changed;
+   struct _config_eet_batch_entry *entry;
+   Eina_List *batch = NULL;
+   Eldbus_Message_Iter *st, *value;
+   struct _config_section *sec;
+   struct wkb_config_key *key;
+   const char *section, *name;
+   char *sig;
+   Eina_Bool valid;
+
+   while (eldbus_message_iter_get_and_next(values, 'r', &st))
+     {
+        if (!eldbus_message_iter_arguments_get(st, "ssv", &section, &name, &value))
+          {
+             ERR("Error reading batch entry");
+             goto end;
+          }
+
+        if (!(sec = wkb_ibus_config_section_find(config_eet, section)) ||
+            !(key = _config_section_find_key(sec, name)))
+          {
+             ERR("Config key '%s/%s' not found", section, name);
+             goto end;
+          }
+
+        sig = eldbus_message_iter_signature_get(value);
+        valid = sig && !strcmp(sig, wkb_config_key_signature(key));
+        if (!valid)
+           ERR("Expecting '%s' for key '%s/%s' got '%s'", wkb_config_key_signature(key), section, name, sig);
+        free(sig);
+
+        if (!valid)
+           goto end;
 
-   top = _config_section_toplevel(sec);
-   ret = wkb_ibus_config_section_write(config_eet, top);
-   eet_sync(config_eet->file);
+        entry = calloc(1, sizeof(*entry));
+        entry->section = sec;
+        entry->key = key;
+        entry->value = value;
+        batch = eina_list_append(batch, entry);
+     }
+
+   ret = EINA_TRUE;
+
+   EINA_LIST_FREE(batch, entry)
+     {
+        if (!wkb_config_key_set(entry->key, entry->value, &changed))
+          {
+             ERR("Error setting new value for key '%s'", wkb_config_key_id(entry->key));
+             ret = EINA_FALSE;
+          }
+        else if (!changed)
+          {
+             config_eet->stats.set_values++;
+             config_eet->stats.values_unchanged++;
+          }
+        else
+          {
+             config_eet->stats.set_values++;
+             _config_eet_value_changed(config_eet, entry->key);
+             _config_eet_section_dirty(config_eet, entry->section);
+          }
+
+        free(entry);
+     }
+
+   if (config_eet->flush_timer)
+     {
+        ecore_timer_del(config_eet->flush_timer);
+        config_eet->flush_timer = NULL;
+     }
+
+   if (config_eet->dirty)
+      _config_eet_flush(config_eet);
 
 end:
+   EINA_LIST_FREE(batch, entry)
+      free(entry);
+
    return ret;
 }
 
@@ -1610,27 +1982,76 @@ wkb_ibus_config_eet_get_value_string_list(struct wkb_ibus_config_eet *config_eet
    return wkb_config_key_get_string_list(key);
 }
 
+const Eina_List *
+wkb_ibus_config_eet_get_value_list(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name)
+{
+   struct wkb_config_key *key;
+
+   if (!(key = wkb_ibus_config_eet_find_key(config_eet, section, name)))
+     {
+        ERR("Config key with id '%s' not found", name);
+        return NULL;
+     }
+
+   return wkb_config_key_get_list(key);
+}
+
 Eina_Bool
 wkb_ibus_config_eet_get_values(struct wkb_ibus_config_eet *config_eet, const char *section, Eldbus_Message_Iter *reply)
 {
-   Eina_Bool ret = EINA_FALSE;
    struct _config_section *sec;
-   struct wkb_config_key *key;
-   Eina_List *node;
-   Eldbus_Message_Iter *dict, *entry;
+   Eldbus_Message_Iter *dict;
 
    if (!(sec = wkb_ibus_config_section_find(config_eet, section)))
      {
         ERR("Config section with id '%s' not found", section);
-        goto end;
+        return EINA_FALSE;
      }
 
+   config_eet->stats.get_values++;
+
+   if (sec->values)
+      config_eet->stats.get_values_cached++;
+   else
+      sec->values = _config_values_new(sec);
+
+   dict = eldbus_message_iter_container_new(reply, 'a', "{sv}");
+   _config_values_append(sec->values, dict);
+   eldbus_message_iter_container_close(reply, dict);
+
+   return EINA_TRUE;
+}
+
+Eina_Bool
+wkb_ibus_config_eet_get_values_multi(struct wkb_ibus_config_eet *config_eet, Eldbus_Message_Iter *names, Eldbus_Message_Iter *reply)
+{
+   Eina_Bool ret = EINA_TRUE;
+   struct wkb_config_key *key;
+   Eldbus_Message_Iter *dict, *entry;
+   const char *path, *name;
+   char section[PATH_MAX];
+
    dict = eldbus_message_iter_container_new(reply, 'a', "{sv}");
 
-   EINA_LIST_FOREACH(sec->keys, node, key)
+   while (eldbus_message_iter_get_and_next(names, 's', &path))
      {
+        if (!(name = strrchr(path, '/')) || (size_t) (name - path) >= sizeof(section))
+          {
+             DBG("Invalid key path '%s'", path);
+             continue;
+          }
+
+        memcpy(section, path, name - path);
+        section[name - path] = '\0';
+
+        if (!(key = wkb_ibus_config_eet_find_key(config_eet, section, ++name)))
+          {
+             DBG("Config key '%s' not found", path);
+             continue;
+          }
+
         entry = eldbus_message_iter_container_new(dict, 'e', NULL);
-        eldbus_message_iter_basic_append(entry, 's', wkb_config_key_id(key));
+        eldbus_message_iter_basic_append(entry, 's', path);
         ret = wkb_config_key_get(key, entry);
         eldbus_message_iter_container_close(dict, entry);
         if (!ret)
@@ -1639,7 +2060,6 @@ wkb_ibus_config_eet_get_values(struct wkb_ibus_config_eet *config_eet, const cha
 
    eldbus_message_iter_container_close(reply, dict);
 
-end:
    return ret;
 }
 
@@ -1649,11 +2069,17 @@ wkb_ibus_config_eet_set_defaults(struct wkb_ibus_config_eet *config_eet)
    struct _config_section *sec;
    Eina_List *node;
 
+   /* Pending notifications and writes refer to the old sections */
+   config_eet->changed = eina_list_free(config_eet->changed);
+   config_eet->dirty = eina_list_free(config_eet->dirty);
+
+   eina_hash_free_buckets(config_eet->sections_index);
+
    EINA_LIST_FREE(config_eet->sections, sec)
       _config_section_free(sec);
 
-   config_eet->sections = eina_list_append(config_eet->sections, _config_ibus_new());
-   config_eet->sections = eina_list_append(config_eet->sections, _config_weekeyboard_new());
+   _config_eet_section_add(config_eet, _config_ibus_new());
+   _config_eet_section_add(config_eet, _config_weekeyboard_new(NULL));
 
    EINA_LIST_FOREACH(config_eet->sections, node, sec)
       _config_section_set_defaults(sec);
@@ -1665,89 +2091,186 @@ _config_eet_init(const char *path, Eldbus_Service_Interface *iface)
    struct wkb_ibus_config_eet *eet = calloc(1, sizeof(*eet));
    eet->iface = iface;
    eet->path = eina_stringshare_add(path);
+   eet->side_path = eina_stringshare_printf("%s.new", path ? path : "");
+   eet->sections_index = eina_hash_string_superfast_new(NULL);
 
    _hotkey_edd = _config_hotkey_edd_new();
-   _general_edd = _config_general_edd_new(_hotkey_edd);
+   _general_edd = _config_general_edd_new(NULL);
    _panel_edd = _config_panel_edd_new();
    _hangul_edd = _config_hangul_edd_new();
    _pinyin_edd = _config_pinyin_edd_new();
    _bopomofo_edd = _config_bopomofo_edd_new();
-   _engine_edd = _config_engine_edd_new(_hangul_edd, _pinyin_edd, _bopomofo_edd);
-   _ibus_edd = _config_ibus_edd_new(_general_edd, _panel_edd, _engine_edd);
    _weekeyboard_edd = _config_weekeyboard_edd_new();
 
-   return eet;
-}
+   _general_legacy_edd = _config_general_edd_new(_hotkey_edd);
+   _engine_legacy_edd = _config_engine_edd_new(_hangul_edd, _pinyin_edd, _bopomofo_edd);
+   _ibus_legacy_edd = _config_ibus_edd_new(_general_legacy_edd, _panel_edd, _engine_legacy_edd);
 
-static Eina_Bool
-_config_eet_exists(const char *path)
-{
-   struct stat buf;
-   return stat(path, &buf) == 0;
+   return eet;
 }
 
 struct wkb_ibus_config_eet *
-wkb_ibus_config_eet_new(const char *path, Eldbus_Service_Interface *iface)
+wkb_ibus_config_eet_backend_new(enum wkb_ibus_config_eet_backend backend, const char *path, Eldbus_Service_Interface *iface)
 {
    struct wkb_ibus_config_eet *eet = _config_eet_init(path, iface);
 
-   if (!(eet->file = eet_open(eet->path, EET_FILE_MODE_READ_WRITE)))
-     {
-        ERR("Error opening Eet file '%s'", eet->path);
-        return EINA_FALSE;
-     }
+   eet->backend = &_config_eet_backends[backend];
+   INF("Using %s config backend '%s'", eet->backend->name, path ? path : "");
+
+   if (!eet->backend->open(eet))
+      goto defaults;
+
+   eet->version = _config_eet_version_read(eet);
+
+   _config_eet_ibus_load(eet);
+   wkb_ibus_config_section_read(eet, weekeyboard);
+   _config_eet_migrate(eet);
+   goto end;
 
-   if (!_config_eet_exists(path))
+defaults:
      {
         Eina_List *node;
         struct _config_section *sec;
 
         wkb_ibus_config_eet_set_defaults(eet);
         EINA_LIST_FOREACH(eet->sections, node, sec)
-           wkb_ibus_config_section_write(eet, sec);
-
-        goto end;
+           _config_eet_section_mark_all(eet, sec);
      }
 
-   wkb_ibus_config_section_read(eet, ibus);
-   wkb_ibus_config_section_read(eet, weekeyboard);
-
 end:
-   eet_sync(eet->file);
+   _config_eet_commit(eet);
    return eet;
 }
 
+struct wkb_ibus_config_eet *
+wkb_ibus_config_eet_new(const char *path, Eldbus_Service_Interface *iface)
+{
+   return wkb_ibus_config_eet_backend_new(WKB_IBUS_CONFIG_EET_BACKEND_FILE, path, iface);
+}
+
+void
+wkb_ibus_config_eet_iface_set(struct wkb_ibus_config_eet *config_eet, Eldbus_Service_Interface *iface)
+{
+   config_eet->iface = iface;
+}
+
+/*
+ * Sections are loaded lazily, all of them must be in place to be published.
+ */
+Eina_Bool
+wkb_ibus_config_eet_publish(struct wkb_ibus_config_eet *config_eet, const char *name)
+{
+   if (config_eet->shm)
+      return EINA_TRUE;
+
+   if (!(config_eet->shm = wkb_ibus_config_shm_new(name)))
+      return EINA_FALSE;
+
+   _config_eet_section_load_all(config_eet);
+   _config_eet_publish(config_eet);
+
+   INF("Config '%s' published in shared memory '%s'", config_eet->path, name);
+   return EINA_TRUE;
+}
+
+void
+wkb_ibus_config_eet_unpublish(struct wkb_ibus_config_eet *config_eet)
+{
+   if (!config_eet->shm)
+      return;
+
+   wkb_ibus_config_shm_free(config_eet->shm);
+   config_eet->shm = NULL;
+
+   INF("Config '%s' no longer published", config_eet->path);
+}
+
+void
+wkb_ibus_config_eet_stats_get(struct wkb_ibus_config_eet *config_eet, struct wkb_ibus_config_eet_stats *stats)
+{
+   *stats = config_eet->stats;
+}
+
+/* Waits for the flush in progress, if any, then commits what is left */
+static void
+_config_eet_commit_now(struct wkb_ibus_config_eet *config_eet)
+{
+   if (config_eet->flush_timer)
+     {
+        ecore_timer_del(config_eet->flush_timer);
+        config_eet->flush_timer = NULL;
+     }
+
+   /* The flush itself is freed by the pending _config_eet_flush_done() */
+   if (config_eet->flush)
+     {
+        eina_thread_join(config_eet->flush->thread);
+        config_eet->flush->config_eet = NULL;
+        _config_eet_commit_done(config_eet, config_eet->flush);
+        config_eet->flush = NULL;
+     }
+
+   _config_eet_commit(config_eet);
+}
+
+void
+wkb_ibus_config_eet_commit(struct wkb_ibus_config_eet *config_eet)
+{
+   _config_eet_commit_now(config_eet);
+}
+
 void
 wkb_ibus_config_eet_free(struct wkb_ibus_config_eet *config_eet)
 {
    struct _config_section *sec;
 
+   if (config_eet->changed_job)
+      ecore_job_del(config_eet->changed_job);
+
+   eina_list_free(config_eet->changed);
+
+   /* Make sure pending changes hit the disk before going away */
+   _config_eet_commit_now(config_eet);
+
+   INF("Config '%s': %u values set (%u unchanged), %u flushes, %u sections written, %u writes avoided, %u GetValues (%u cached)",
+       config_eet->path, config_eet->stats.set_values, config_eet->stats.values_unchanged,
+       config_eet->stats.flushes, config_eet->stats.sections_written, config_eet->stats.writes_avoided,
+       config_eet->stats.get_values, config_eet->stats.get_values_cached);
+
+   wkb_ibus_config_shm_free(config_eet->shm);
+   eina_hash_free(config_eet->sections_index);
+
    EINA_LIST_FREE(config_eet->sections, sec)
       _config_section_free(sec);
 
    eina_stringshare_del(config_eet->path);
 
+   eet_data_descriptor_free(_ibus_legacy_edd);
+   eet_data_descriptor_free(_engine_legacy_edd);
+   eet_data_descriptor_free(_general_legacy_edd);
    eet_data_descriptor_free(_hotkey_edd);
    eet_data_descriptor_free(_general_edd);
    eet_data_descriptor_free(_panel_edd);
    eet_data_descriptor_free(_hangul_edd);
    eet_data_descriptor_free(_pinyin_edd);
    eet_data_descriptor_free(_bopomofo_edd);
-   eet_data_descriptor_free(_engine_edd);
-   eet_data_descriptor_free(_ibus_edd);
    eet_data_descriptor_free(_weekeyboard_edd);
 
+   _ibus_legacy_edd = NULL;
+   _engine_legacy_edd = NULL;
+   _general_legacy_edd = NULL;
    _hotkey_edd = NULL;
    _general_edd = NULL;
    _panel_edd = NULL;
    _hangul_edd = NULL;
    _pinyin_edd = NULL;
    _bopomofo_edd = NULL;
-   _engine_edd = NULL;
-   _ibus_edd = NULL;
    _weekeyboard_edd = NULL;
 
-   eet_close(config_eet->file);
+   if (config_eet->file)
+      eet_close(config_eet->file);
+
+   eina_stringshare_del(config_eet->side_path);
    free(config_eet);
 }
 
@@ -1784,6 +2307,8 @@ wkb_ibus_config_eet_dump(struct wkb_ibus_config_eet *eet)
    Eina_List *node;
    struct _config_section *sec;
 
+   _config_eet_section_load_all(eet);
+
    EINA_LIST_FOREACH(eet->sections, node, sec)
      {
         printf("'%s'\n", sec->id);
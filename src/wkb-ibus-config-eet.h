@@ -21,23 +21,57 @@
 #include <Eina.h>
 #include <Eldbus.h>
 
+#include "wkb-ibus-config-key.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct wkb_ibus_config_eet;
-struct wkb_config_key;
+
+struct wkb_ibus_config_eet_stats
+{
+   unsigned int set_values;
+   unsigned int values_unchanged;
+   unsigned int flushes;
+   unsigned int sections_written;
+   unsigned int writes_avoided;
+   unsigned int get_values;
+   unsigned int get_values_cached;
+};
 
 struct wkb_config_key *wkb_ibus_config_eet_find_key(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name);
 
+/* Subscribe to a key, or to every key of a section when name is NULL */
+Eina_Bool wkb_ibus_config_eet_callback_add(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name, wkb_config_key_changed_cb cb, const void *data);
+void wkb_ibus_config_eet_callback_del(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name, wkb_config_key_changed_cb cb, const void *data);
+
 Eina_Bool wkb_ibus_config_eet_set_value(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name, Eldbus_Message_Iter *value);
 Eina_Bool wkb_ibus_config_eet_get_value(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name, Eldbus_Message_Iter *reply);
 Eina_Bool wkb_ibus_config_eet_get_values(struct wkb_ibus_config_eet *config_eet, const char *section, Eldbus_Message_Iter *reply);
+Eina_Bool wkb_ibus_config_eet_set_values(struct wkb_ibus_config_eet *config_eet, Eldbus_Message_Iter *values);
+Eina_Bool wkb_ibus_config_eet_get_values_multi(struct wkb_ibus_config_eet *config_eet, Eldbus_Message_Iter *names, Eldbus_Message_Iter *reply);
 
 void wkb_ibus_config_eet_set_defaults(struct wkb_ibus_config_eet *config_eet);
 
+enum wkb_ibus_config_eet_backend
+{
+   WKB_IBUS_CONFIG_EET_BACKEND_FILE, /* read from and committed to path */
+   WKB_IBUS_CONFIG_EET_BACKEND_IMAGE, /* read from the Eet image at path, never written */
+   WKB_IBUS_CONFIG_EET_BACKEND_MEMORY, /* built in defaults, path unused, never written */
+};
+
 struct wkb_ibus_config_eet *wkb_ibus_config_eet_new(const char *path, Eldbus_Service_Interface *iface);
+struct wkb_ibus_config_eet *wkb_ibus_config_eet_backend_new(enum wkb_ibus_config_eet_backend backend, const char *path, Eldbus_Service_Interface *iface);
 void wkb_ibus_config_eet_free(struct wkb_ibus_config_eet *config_eet);
+void wkb_ibus_config_eet_iface_set(struct wkb_ibus_config_eet *config_eet, Eldbus_Service_Interface *iface);
+/* Commits pending changes right away instead of after the flush delay */
+void wkb_ibus_config_eet_commit(struct wkb_ibus_config_eet *config_eet);
+void wkb_ibus_config_eet_stats_get(struct wkb_ibus_config_eet *config_eet, struct wkb_ibus_config_eet_stats *stats);
+
+/* Keeps a snapshot of all keys in shared memory, see wkb-ibus-config-shm.h */
+Eina_Bool wkb_ibus_config_eet_publish(struct wkb_ibus_config_eet *config_eet, const char *name);
+void wkb_ibus_config_eet_unpublish(struct wkb_ibus_config_eet *config_eet);
 
 int wkb_ibus_config_eet_init(void);
 void wkb_ibus_config_eet_shutdown(void);
@@ -46,6 +80,7 @@ int wkb_ibus_config_eet_get_value_int(struct wkb_ibus_config_eet *config_eet, co
 Eina_Bool wkb_ibus_config_eet_get_value_bool(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name);
 const char *wkb_ibus_config_eet_get_value_string(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name);
 char **wkb_ibus_config_eet_get_value_string_list(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name);
+const Eina_List *wkb_ibus_config_eet_get_value_list(struct wkb_ibus_config_eet *config_eet, const char *section, const char *name);
 void wkb_ibus_config_eet_dump(struct wkb_ibus_config_eet *config_eet);
 #ifdef __cplusplus
 }
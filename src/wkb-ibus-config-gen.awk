@@ -0,0 +1,214 @@
+#
+# Copyright © 2014 Jaguar Landrover
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+#
+# Generates the config section structs and key tables used by
+# wkb-ibus-config-eet.c from the GSettings schemas in data/schemas:
+#
+#    awk -f wkb-ibus-config-gen.awk data/schemas/*.gschema.xml > wkb-ibus-config-sections.h
+#
+# Only the subset of the schema format found there is understood, one element
+# per line. The section id is the last component of the schema id, and the
+# struct field of each key is its name in lower case with '-' replaced by '_'.
+#
+
+function attr(line, name)
+{
+   if (!match(line, name "=\"[^\"]*\""))
+      return ""
+
+   return substr(line, RSTART + length(name) + 2, RLENGTH - length(name) - 3)
+}
+
+function canonical(str)
+{
+   str = tolower(str)
+   gsub(/-/, "_", str)
+   return str
+}
+
+function cstring(str)
+{
+   gsub(/&lt;/, "<", str)
+   gsub(/&gt;/, ">", str)
+   gsub(/&apos;/, "'", str)
+   gsub(/&quot;/, "\"", str)
+   gsub(/&amp;/, "\\&", str)
+   if (str ~ /["\\]/)
+      fail("unsupported character in " str)
+   return "\"" str "\""
+}
+
+function fail(msg)
+{
+   printf("%s:%d: %s\n", FILENAME, FNR, msg) > "/dev/stderr"
+   failed = 1
+   exit 1
+}
+
+function default_value(type, value,    list)
+{
+   if (type == "as")
+     {
+        list = ""
+        while (match(value, /'[^']*'/))
+          {
+             list = list cstring(substr(value, RSTART + 1, RLENGTH - 2)) ", "
+             value = substr(value, RSTART + RLENGTH)
+          }
+        return ".list = (const char *[]) { " list "NULL }"
+     }
+
+   if (type == "s")
+     {
+        if (!match(value, /^'[^']*'$/))
+           fail("invalid string default " value)
+        return ".s = " cstring(substr(value, 2, length(value) - 2))
+     }
+
+   if (type == "i")
+     {
+        if (value !~ /^-?[0-9]+$/)
+           fail("invalid int default " value)
+        return ".i = " value
+     }
+
+   if (type == "b")
+     {
+        if (value == "true")
+           return ".b = EINA_TRUE"
+        if (value == "false")
+           return ".b = EINA_FALSE"
+        fail("invalid bool default " value)
+     }
+
+   fail("unsupported key type " type)
+}
+
+function field_type(type)
+{
+   if (type == "as")
+      return "Eina_List *"
+   if (type == "s")
+      return "const char *"
+   if (type == "i")
+      return "int "
+   if (type == "b")
+      return "Eina_Bool "
+
+   fail("unsupported key type " type)
+}
+
+BEGIN {
+   print "/* Generated by wkb-ibus-config-gen.awk, do not edit */"
+   print ""
+   print "#ifndef _WKB_IBUS_CONFIG_SECTIONS_H_"
+   print "#define _WKB_IBUS_CONFIG_SECTIONS_H_"
+   print ""
+   print "#include <stddef.h>"
+   section = ""
+}
+
+/<schema / {
+   if (section != "")
+      fail("nested schema")
+
+   schema = attr($0, "id")
+   section = schema
+   sub(/.*\./, "", section)
+   if (section == "")
+      fail("schema without id")
+
+   nkeys = 0
+   nchildren = 0
+   key = ""
+   next
+}
+
+/<child / {
+   if (section == "")
+      fail("child outside of schema")
+
+   children[++nchildren] = attr($0, "name")
+   next
+}
+
+/<key / {
+   if (section == "" || key != "")
+      fail("unexpected key")
+
+   key = attr($0, "name")
+   keys[++nkeys] = key
+   types[nkeys] = attr($0, "type")
+   defaults[nkeys] = ""
+   next
+}
+
+/<default>/ {
+   if (key == "")
+      fail("default outside of key")
+
+   value = $0
+   sub(/.*<default>/, "", value)
+   sub(/<\/default>.*/, "", value)
+   defaults[nkeys] = default_value(types[nkeys], value)
+   next
+}
+
+/<\/key>/ {
+   if (defaults[nkeys] == "")
+      fail("key " key " without default")
+
+   key = ""
+   next
+}
+
+/<\/schema>/ {
+   print ""
+   print "/*"
+   print " * " schema
+   print " */"
+   print "struct _config_" section
+   print "{"
+   print "   struct _config_section base;"
+   if (nchildren)
+      print ""
+   for (i = 1; i <= nchildren; i++)
+      print "   struct _config_section *" children[i] ";"
+   print ""
+   for (i = 1; i <= nkeys; i++)
+      print "   " field_type(types[i]) canonical(keys[i]) ";"
+   print "};"
+   print ""
+   print "static const struct _config_key_desc _config_" section "_keys[] ="
+   print "{"
+   for (i = 1; i <= nkeys; i++)
+      printf("   { \"%s\", \"%s\", \"%s\", offsetof(struct _config_%s, %s), { %s } },\n",
+             keys[i], canonical(keys[i]), types[i], section, canonical(keys[i]), defaults[i])
+   print "   { NULL }"
+   print "};"
+
+   section = ""
+   next
+}
+
+END {
+   if (failed)
+      exit 1
+
+   print ""
+   print "#endif /* _WKB_IBUS_CONFIG_SECTIONS_H_ */"
+}
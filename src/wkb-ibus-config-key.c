@@ -26,7 +26,7 @@
 #include "wkb-log.h"
 
 typedef void (*key_free_cb) (void *);
-typedef Eina_Bool (*key_set_cb) (struct wkb_config_key *, Eldbus_Message_Iter *);
+typedef Eina_Bool (*key_set_cb) (struct wkb_config_key *, Eldbus_Message_Iter *, Eina_Bool *);
 typedef Eina_Bool (*key_get_cb) (struct wkb_config_key *, Eldbus_Message_Iter *);
 
 struct wkb_config_key
@@ -39,6 +39,14 @@ struct wkb_config_key
    key_free_cb free;
    key_set_cb set;
    key_get_cb get;
+
+   Eina_List *callbacks;
+};
+
+struct _key_callback
+{
+   wkb_config_key_changed_cb cb;
+   const void *data;
 };
 
 static struct wkb_config_key *
@@ -64,6 +72,7 @@ _key_new(const char *id, const char *section, const char *signature, void *field
              ERR("Error decoding " #_type " value using '%s'", _key->signature); \
              return EINA_FALSE; \
           } \
+        *changed = (*__field != __value); \
         *__field = __value; \
         return EINA_TRUE; \
    } while (0)
@@ -75,7 +84,7 @@ _key_new(const char *id, const char *section, const char *signature, void *field
    } while (0)
 
 static Eina_Bool
-_key_int_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter)
+_key_int_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter, Eina_Bool *changed)
 {
    _key_basic_set(key, int);
 }
@@ -87,7 +96,7 @@ _key_int_get(struct wkb_config_key *key, Eldbus_Message_Iter *reply)
 }
 
 static Eina_Bool
-_key_bool_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter)
+_key_bool_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter, Eina_Bool *changed)
 {
    _key_basic_set(key, Eina_Bool);
 }
@@ -109,10 +118,10 @@ _key_string_free(const char **str)
 }
 
 static Eina_Bool
-_key_string_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter)
+_key_string_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter, Eina_Bool *changed)
 {
    const char *str = NULL;
-   const char **field;
+   const char **field = (const char **) key->field;
 
    if (iter && !eldbus_message_iter_arguments_get(iter, "s", &str))
      {
@@ -120,11 +129,12 @@ _key_string_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter)
         return EINA_FALSE;
      }
 
-   if ((field = (const char **) key->field))
-      _key_string_free(field);
+   /* stringshares, comparing the pointers is enough */
+   str = eina_stringshare_add(str);
+   *changed = (*field != str);
 
-   if (str)
-      *field = eina_stringshare_add(str);
+   _key_string_free(field);
+   *field = str;
 
    INF("Setting key <%s/%s> to <%s>", key->section, key->id, *field);
 
@@ -153,11 +163,24 @@ _key_string_list_free(Eina_List **list)
 }
 
 static Eina_Bool
-_key_string_list_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter)
+_key_string_list_equal(Eina_List *a, Eina_List *b)
+{
+   if (eina_list_count(a) != eina_list_count(b))
+      return EINA_FALSE;
+
+   for (; a && b; a = eina_list_next(a), b = eina_list_next(b))
+      if (eina_list_data_get(a) != eina_list_data_get(b))
+         return EINA_FALSE;
+
+   return EINA_TRUE;
+}
+
+static Eina_Bool
+_key_string_list_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter, Eina_Bool *changed)
 {
    const char *str;
    Eina_List *list = NULL;
-   Eina_List **field;
+   Eina_List **field = (Eina_List **) key->field;
    Eldbus_Message_Iter *array = NULL;
 
    if (!eldbus_message_iter_arguments_get(iter, "as", &array))
@@ -169,10 +192,16 @@ _key_string_list_set(struct wkb_config_key *key, Eldbus_Message_Iter *iter)
    while (eldbus_message_iter_get_and_next(array, 's', &str))
       list = eina_list_append(list, eina_stringshare_add(str));
 
-   if ((field = (Eina_List **) key->field))
-      _key_string_list_free(field);
+   if (_key_string_list_equal(*field, list))
+     {
+        _key_string_list_free(&list);
+        *changed = EINA_FALSE;
+        return EINA_TRUE;
+     }
 
+   _key_string_list_free(field);
    *field = list;
+   *changed = EINA_TRUE;
 
    return EINA_TRUE;
 }
@@ -224,6 +253,11 @@ wkb_config_key_string_list(const char *id, const char *section, void *field)
 void
 wkb_config_key_free(struct wkb_config_key *key)
 {
+   struct _key_callback *callback;
+
+   EINA_LIST_FREE(key->callbacks, callback)
+      free(callback);
+
    if (key->free && key->field)
       key->free(key->field);
 
@@ -252,12 +286,14 @@ wkb_config_key_signature(struct wkb_config_key *key)
 }
 
 Eina_Bool
-wkb_config_key_set(struct wkb_config_key * key, Eldbus_Message_Iter *iter)
+wkb_config_key_set(struct wkb_config_key * key, Eldbus_Message_Iter *iter, Eina_Bool *changed)
 {
+   Eina_Bool dummy;
+
    if (!key->field || !key->set)
       return EINA_FALSE;
 
-   return key->set(key, iter);
+   return key->set(key, iter, changed ? changed : &dummy);
 }
 
 Eina_Bool
@@ -281,6 +317,66 @@ wkb_config_key_get(struct wkb_config_key *key, Eldbus_Message_Iter *reply)
    return ret;
 }
 
+void
+wkb_config_key_callback_add(struct wkb_config_key *key, wkb_config_key_changed_cb cb, const void *data)
+{
+   struct _key_callback *callback = calloc(1, sizeof(*callback));
+
+   callback->cb = cb;
+   callback->data = data;
+   key->callbacks = eina_list_append(key->callbacks, callback);
+}
+
+void
+wkb_config_key_callback_del(struct wkb_config_key *key, wkb_config_key_changed_cb cb, const void *data)
+{
+   struct _key_callback *callback;
+   Eina_List *node;
+
+   EINA_LIST_FOREACH(key->callbacks, node, callback)
+     {
+        if (callback->cb != cb || callback->data != data)
+           continue;
+
+        key->callbacks = eina_list_remove_list(key->callbacks, node);
+        free(callback);
+        return;
+     }
+}
+
+void
+wkb_config_key_changed(struct wkb_config_key *key, const union wkb_config_value *value)
+{
+   struct _key_callback *callback;
+   Eina_List *node, *next;
+
+   EINA_LIST_FOREACH_SAFE(key->callbacks, node, next, callback)
+      callback->cb((void *) callback->data, key, value);
+}
+
+void
+wkb_config_key_value_get(struct wkb_config_key *key, union wkb_config_value *value)
+{
+   switch (*key->signature)
+     {
+      case 'i':
+         value->i = *((int *) key->field);
+         break;
+      case 'b':
+         value->b = *((Eina_Bool *) key->field);
+         break;
+      case 's':
+         value->s = *((const char **) key->field);
+         break;
+      case 'a':
+         value->list = *((Eina_List **) key->field);
+         break;
+      default:
+         memset(value, 0, sizeof(*value));
+         break;
+     }
+}
+
 int
 wkb_config_key_get_int(struct wkb_config_key* key)
 {
@@ -324,3 +420,11 @@ wkb_config_key_get_string_list(struct wkb_config_key *key)
    return ret;
 }
 
+const Eina_List *
+wkb_config_key_get_list(struct wkb_config_key *key)
+{
+   assert(!strcmp(key->signature, "as"));
+
+   return *((Eina_List **) key->field);
+}
+
@@ -27,6 +27,17 @@ extern "C" {
 
 struct wkb_config_key;
 
+/* Typed value of a key, the member in use is given by the key signature */
+union wkb_config_value
+{
+   int i;
+   Eina_Bool b;
+   const char *s; /* stringshare */
+   const Eina_List *list; /* borrowed list of stringshares */
+};
+
+typedef void (*wkb_config_key_changed_cb)(void *data, struct wkb_config_key *key, const union wkb_config_value *value);
+
 struct wkb_config_key *wkb_config_key_int(const char *id, const char *section, void *field);
 struct wkb_config_key *wkb_config_key_bool(const char *id, const char *section, void *field);
 struct wkb_config_key *wkb_config_key_string(const char *id, const char *section, void *field);
@@ -36,14 +47,23 @@ void wkb_config_key_free(struct wkb_config_key *key);
 const char *wkb_config_key_id(struct wkb_config_key *key);
 const char *wkb_config_key_section(struct wkb_config_key *key);
 const char *wkb_config_key_signature(struct wkb_config_key *key);
-Eina_Bool wkb_config_key_set(struct wkb_config_key * key, Eldbus_Message_Iter *iter);
+Eina_Bool wkb_config_key_set(struct wkb_config_key * key, Eldbus_Message_Iter *iter, Eina_Bool *changed);
 Eina_Bool wkb_config_key_get(struct wkb_config_key *key, Eldbus_Message_Iter *reply);
 
+/* Called once per main loop iteration in which the value changed */
+void wkb_config_key_callback_add(struct wkb_config_key *key, wkb_config_key_changed_cb cb, const void *data);
+void wkb_config_key_callback_del(struct wkb_config_key *key, wkb_config_key_changed_cb cb, const void *data);
+void wkb_config_key_changed(struct wkb_config_key *key, const union wkb_config_value *value);
+void wkb_config_key_value_get(struct wkb_config_key *key, union wkb_config_value *value);
+
 int         wkb_config_key_get_int(struct wkb_config_key* key);
 Eina_Bool   wkb_config_key_get_bool(struct wkb_config_key* key);
 const char *wkb_config_key_get_string(struct wkb_config_key* key);
 char      **wkb_config_key_get_string_list(struct wkb_config_key *key);
 
+/* Borrowed list of stringshares, valid until the value changes */
+const Eina_List *wkb_config_key_get_list(struct wkb_config_key *key);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,543 @@
+/*
+ * Copyright © 2014 Jaguar Landrover
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "wkb-ibus-config-shm.h"
+#include "wkb-ibus-config-key.h"
+#include "wkb-log.h"
+
+#define WKB_CONFIG_SHM_MAGIC 0x43424b57 /* "WKBC" */
+#define WKB_CONFIG_SHM_LAYOUT 1
+#define WKB_CONFIG_SHM_SIZE (64 * 1024)
+#define WKB_CONFIG_SHM_RETRIES 100
+
+/*
+ * The region is the header followed by 'size' bytes of entries, each one:
+ *
+ *    uint32_t length, of the whole entry
+ *    section, key id and signature, NUL terminated
+ *    value: int32_t for 'i', uint8_t for 'b', a NUL terminated string for
+ *           's', uint32_t count followed by as many strings for 'as'
+ *
+ * The owner makes seq odd while writing and bumps generation on each publish.
+ */
+struct _shm_header
+{
+   uint32_t magic;
+   uint32_t layout;
+   uint32_t seq;
+   uint32_t generation;
+   uint32_t size;
+   uint32_t count;
+};
+
+#define WKB_CONFIG_SHM_DATA_SIZE (WKB_CONFIG_SHM_SIZE - sizeof(struct _shm_header))
+
+struct wkb_ibus_config_shm
+{
+   char *name;
+   int fd; /* kept open, holding the owner lock */
+   struct _shm_header *header;
+   char *data;
+   uint32_t used;
+   uint32_t count;
+   Eina_Bool overflow;
+};
+
+struct wkb_ibus_config_snapshot
+{
+   unsigned int generation;
+   uint32_t size;
+   uint32_t count;
+   char data[];
+};
+
+const char *
+wkb_ibus_config_shm_name(void)
+{
+   static char name[NAME_MAX];
+
+   if (!*name)
+      snprintf(name, sizeof(name), "/weekeyboard-config-%u", (unsigned int) getuid());
+
+   return name;
+}
+
+/*
+ * Owner
+ *
+ * Only one instance publishes at a time: the owner holds an exclusive lock
+ * on the region for as long as it publishes. A region left behind by an
+ * owner that died is taken over by the next one.
+ */
+struct wkb_ibus_config_shm *
+wkb_ibus_config_shm_new(const char *name)
+{
+   struct wkb_ibus_config_shm *shm = NULL;
+   void *map;
+   int fd;
+
+   if ((fd = shm_open(name, O_RDWR | O_CREAT, 0600)) < 0)
+     {
+        ERR("Error creating shared memory '%s'", name);
+        goto end;
+     }
+
+   if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+     {
+        INF("Shared memory '%s' is published by another instance", name);
+        goto err;
+     }
+
+   /* Left behind by older versions, the config is nobody else's business */
+   if (fchmod(fd, 0600) != 0)
+     {
+        ERR("Error restricting access to shared memory '%s'", name);
+        goto err;
+     }
+
+   if (ftruncate(fd, WKB_CONFIG_SHM_SIZE) != 0)
+     {
+        ERR("Error sizing shared memory '%s'", name);
+        goto err;
+     }
+
+   if ((map = mmap(NULL, WKB_CONFIG_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+     {
+        ERR("Error mapping shared memory '%s'", name);
+        goto err;
+     }
+
+   shm = calloc(1, sizeof(*shm));
+   shm->name = strdup(name);
+   shm->fd = fd;
+   shm->header = map;
+   shm->data = (char *) map + sizeof(struct _shm_header);
+
+   /* The previous owner may have died while publishing */
+   if (shm->header->seq & 1)
+      __atomic_store_n(&shm->header->seq, shm->header->seq + 1, __ATOMIC_RELEASE);
+
+   shm->header->layout = WKB_CONFIG_SHM_LAYOUT;
+   __atomic_store_n(&shm->header->magic, WKB_CONFIG_SHM_MAGIC, __ATOMIC_RELEASE);
+
+   goto end;
+
+err:
+   close(fd);
+
+end:
+   return shm;
+}
+
+void
+wkb_ibus_config_shm_free(struct wkb_ibus_config_shm *shm)
+{
+   if (!shm)
+      return;
+
+   munmap(shm->header, WKB_CONFIG_SHM_SIZE);
+
+   /* Still holding the lock, the region is ours to remove */
+   shm_unlink(shm->name);
+   close(shm->fd);
+
+   free(shm->name);
+   free(shm);
+}
+
+void
+wkb_ibus_config_shm_begin(struct wkb_ibus_config_shm *shm)
+{
+   __atomic_store_n(&shm->header->seq, shm->header->seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   shm->used = 0;
+   shm->count = 0;
+   shm->overflow = EINA_FALSE;
+}
+
+static Eina_Bool
+_shm_put(struct wkb_ibus_config_shm *shm, const void *data, size_t len)
+{
+   if (shm->used + len > WKB_CONFIG_SHM_DATA_SIZE)
+      return EINA_FALSE;
+
+   memcpy(shm->data + shm->used, data, len);
+   shm->used += len;
+
+   return EINA_TRUE;
+}
+
+static Eina_Bool
+_shm_put_string(struct wkb_ibus_config_shm *shm, const char *str)
+{
+   if (!str)
+      str = "";
+
+   return _shm_put(shm, str, strlen(str) + 1);
+}
+
+Eina_Bool
+wkb_ibus_config_shm_add(struct wkb_ibus_config_shm *shm, struct wkb_config_key *key)
+{
+   uint32_t start = shm->used, length = 0, count;
+   const char *signature = wkb_config_key_signature(key);
+   union wkb_config_value value;
+   const Eina_List *node;
+   const char *str;
+   int32_t i;
+   uint8_t b;
+   Eina_Bool ret;
+
+   wkb_config_key_value_get(key, &value);
+
+   ret = _shm_put(shm, &length, sizeof(length)) &&
+         _shm_put_string(shm, wkb_config_key_section(key)) &&
+         _shm_put_string(shm, wkb_config_key_id(key)) &&
+         _shm_put_string(shm, signature);
+
+   switch (*signature)
+     {
+      case 'i':
+         i = value.i;
+         ret = ret && _shm_put(shm, &i, sizeof(i));
+         break;
+      case 'b':
+         b = value.b;
+         ret = ret && _shm_put(shm, &b, sizeof(b));
+         break;
+      case 's':
+         ret = ret && _shm_put_string(shm, value.s);
+         break;
+      case 'a':
+         count = eina_list_count(value.list);
+         ret = ret && _shm_put(shm, &count, sizeof(count));
+         EINA_LIST_FOREACH(value.list, node, str)
+            ret = ret && _shm_put_string(shm, str);
+         break;
+      default:
+         ret = EINA_FALSE;
+         break;
+     }
+
+   if (!ret)
+     {
+        if (!shm->overflow)
+           ERR("No room left in shared memory '%s' for key '%s/%s'", shm->name,
+               wkb_config_key_section(key), wkb_config_key_id(key));
+
+        shm->overflow = EINA_TRUE;
+        shm->used = start;
+        return EINA_FALSE;
+     }
+
+   length = shm->used - start;
+   memcpy(shm->data + start, &length, sizeof(length));
+   shm->count++;
+
+   return EINA_TRUE;
+}
+
+void
+wkb_ibus_config_shm_end(struct wkb_ibus_config_shm *shm)
+{
+   shm->header->size = shm->used;
+   shm->header->count = shm->count;
+   shm->header->generation++;
+
+   __atomic_store_n(&shm->header->seq, shm->header->seq + 1, __ATOMIC_RELEASE);
+
+   DBG("Published %u keys, %u bytes, generation %u to '%s'",
+       shm->count, shm->used, shm->header->generation, shm->name);
+}
+
+/*
+ * Readers
+ */
+struct wkb_ibus_config_snapshot *
+wkb_ibus_config_snapshot_get(const char *name)
+{
+   struct wkb_ibus_config_snapshot *snapshot = NULL;
+   const struct _shm_header *header;
+   struct stat st;
+   uint32_t seq;
+   void *map;
+   int fd, i;
+
+   if ((fd = shm_open(name, O_RDONLY, 0)) < 0)
+      return NULL;
+
+   if (fstat(fd, &st) != 0 || st.st_size < WKB_CONFIG_SHM_SIZE)
+     {
+        close(fd);
+        return NULL;
+     }
+
+   map = mmap(NULL, WKB_CONFIG_SHM_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (map == MAP_FAILED)
+      return NULL;
+
+   header = map;
+
+   if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != WKB_CONFIG_SHM_MAGIC ||
+       header->layout != WKB_CONFIG_SHM_LAYOUT)
+     {
+        ERR("Unexpected layout in shared memory '%s'", name);
+        goto end;
+     }
+
+   snapshot = malloc(sizeof(*snapshot) + WKB_CONFIG_SHM_DATA_SIZE);
+
+   for (i = 0; i < WKB_CONFIG_SHM_RETRIES; i++)
+     {
+        seq = __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+
+        /* Owner publishing right now */
+        if (seq & 1)
+          {
+             sched_yield();
+             continue;
+          }
+
+        snapshot->size = header->size;
+        snapshot->count = header->count;
+        snapshot->generation = header->generation;
+
+        if (snapshot->size > WKB_CONFIG_SHM_DATA_SIZE)
+           continue;
+
+        memcpy(snapshot->data, (const char *) map + sizeof(*header), snapshot->size);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&header->seq, __ATOMIC_RELAXED) == seq)
+           goto end;
+     }
+
+   ERR("No consistent snapshot in shared memory '%s'", name);
+   free(snapshot);
+   snapshot = NULL;
+
+end:
+   munmap(map, WKB_CONFIG_SHM_SIZE);
+   return snapshot;
+}
+
+void
+wkb_ibus_config_snapshot_free(struct wkb_ibus_config_snapshot *snapshot)
+{
+   free(snapshot);
+}
+
+unsigned int
+wkb_ibus_config_snapshot_generation(struct wkb_ibus_config_snapshot *snapshot)
+{
+   return snapshot->generation;
+}
+
+struct _snapshot_entry
+{
+   const char *section;
+   const char *id;
+   const char *signature;
+   const char *value;
+};
+
+static Eina_Bool
+_snapshot_entry_next(struct wkb_ibus_config_snapshot *snapshot, uint32_t *offset, struct _snapshot_entry *entry)
+{
+   uint32_t length;
+
+   if (*offset + sizeof(length) > snapshot->size)
+      return EINA_FALSE;
+
+   memcpy(&length, snapshot->data + *offset, sizeof(length));
+   if (length <= sizeof(length) || *offset + length > snapshot->size)
+      return EINA_FALSE;
+
+   entry->section = snapshot->data + *offset + sizeof(length);
+   entry->id = entry->section + strlen(entry->section) + 1;
+   entry->signature = entry->id + strlen(entry->id) + 1;
+   entry->value = entry->signature + strlen(entry->signature) + 1;
+
+   *offset += length;
+   return EINA_TRUE;
+}
+
+/* Same canonical form as the config store: lower case, '-' replaced by '_' */
+static const char *
+_snapshot_canonical(const char *str, char *buf, size_t size)
+{
+   size_t i;
+
+   for (i = 0; str[i]; i++)
+     {
+        if (i == size - 1)
+           return NULL;
+
+        if (str[i] == '-')
+           buf[i] = '_';
+        else if (str[i] >= 'A' && str[i] <= 'Z')
+           buf[i] = str[i] + ('a' - 'A');
+        else
+           buf[i] = str[i];
+     }
+   buf[i] = '\0';
+
+   return buf;
+}
+
+static Eina_Bool
+_snapshot_find(struct wkb_ibus_config_snapshot *snapshot, const char *section, const char *name, const char *signature, struct _snapshot_entry *entry)
+{
+   char section_buf[PATH_MAX], name_buf[NAME_MAX];
+   uint32_t offset = 0;
+
+   if (!snapshot ||
+       !(section = _snapshot_canonical(section, section_buf, sizeof(section_buf))) ||
+       !(name = _snapshot_canonical(name, name_buf, sizeof(name_buf))))
+      return EINA_FALSE;
+
+   while (_snapshot_entry_next(snapshot, &offset, entry))
+     {
+        if (strcmp(entry->id, name) || strcmp(entry->section, section))
+           continue;
+
+        return strcmp(entry->signature, signature) == 0;
+     }
+
+   return EINA_FALSE;
+}
+
+Eina_Bool
+wkb_ibus_config_snapshot_get_int(struct wkb_ibus_config_snapshot *snapshot, const char *section, const char *name, int *value)
+{
+   struct _snapshot_entry entry;
+   int32_t i;
+
+   if (!_snapshot_find(snapshot, section, name, "i", &entry))
+      return EINA_FALSE;
+
+   memcpy(&i, entry.value, sizeof(i));
+   *value = i;
+
+   return EINA_TRUE;
+}
+
+Eina_Bool
+wkb_ibus_config_snapshot_get_bool(struct wkb_ibus_config_snapshot *snapshot, const char *section, const char *name, Eina_Bool *value)
+{
+   struct _snapshot_entry entry;
+
+   if (!_snapshot_find(snapshot, section, name, "b", &entry))
+      return EINA_FALSE;
+
+   *value = *(const uint8_t *) entry.value ? EINA_TRUE : EINA_FALSE;
+
+   return EINA_TRUE;
+}
+
+const char *
+wkb_ibus_config_snapshot_get_string(struct wkb_ibus_config_snapshot *snapshot, const char *section, const char *name)
+{
+   struct _snapshot_entry entry;
+
+   if (!_snapshot_find(snapshot, section, name, "s", &entry))
+      return NULL;
+
+   return entry.value;
+}
+
+char **
+wkb_ibus_config_snapshot_get_string_list(struct wkb_ibus_config_snapshot *snapshot, const char *section, const char *name)
+{
+   struct _snapshot_entry entry;
+   const char *str;
+   uint32_t i, count;
+   char **ret;
+
+   if (!_snapshot_find(snapshot, section, name, "as", &entry))
+      return NULL;
+
+   memcpy(&count, entry.value, sizeof(count));
+   str = entry.value + sizeof(count);
+
+   ret = calloc(count + 1, sizeof(char *));
+   for (i = 0; i < count; i++)
+     {
+        ret[i] = (char *) str;
+        str += strlen(str) + 1;
+     }
+
+   return ret;
+}
+
+void
+wkb_ibus_config_snapshot_dump(struct wkb_ibus_config_snapshot *snapshot)
+{
+   struct _snapshot_entry entry;
+   uint32_t offset = 0, i, count;
+   const char *str;
+   int32_t value;
+
+   printf("generation %u, %u keys, %u bytes\n", snapshot->generation, snapshot->count, snapshot->size);
+
+   while (_snapshot_entry_next(snapshot, &offset, &entry))
+     {
+        printf("'%s/%s': ", entry.section, entry.id);
+        switch (*entry.signature)
+          {
+           case 'i':
+              memcpy(&value, entry.value, sizeof(value));
+              printf("%d\n", value);
+              break;
+           case 'b':
+              printf("%s\n", *entry.value ? "True" : "False");
+              break;
+           case 's':
+              printf("'%s'\n", entry.value);
+              break;
+           case 'a':
+              memcpy(&count, entry.value, sizeof(count));
+              str = entry.value + sizeof(count);
+              printf("{");
+              for (i = 0; i < count; i++)
+                {
+                   printf("'%s',", str);
+                   str += strlen(str) + 1;
+                }
+              printf("}\n");
+              break;
+           default:
+              printf("?\n");
+              break;
+          }
+     }
+}
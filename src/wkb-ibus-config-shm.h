@@ -0,0 +1,61 @@
+/*
+ * Copyright © 2014 Jaguar Landrover
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _WKB_IBUS_CONFIG_SHM_H_
+#define _WKB_IBUS_CONFIG_SHM_H_
+
+#include <Eina.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Read only snapshot of every config key, published in shared memory by the
+ * process owning the config store. Readers never lock: they copy the region
+ * and retry if the owner published in the meantime (seqlock).
+ */
+struct wkb_config_key;
+struct wkb_ibus_config_shm;
+struct wkb_ibus_config_snapshot;
+
+/* Per user region name, for both sides */
+const char *wkb_ibus_config_shm_name(void);
+
+/* Owner side, keys are added between begin and end */
+struct wkb_ibus_config_shm *wkb_ibus_config_shm_new(const char *name);
+void wkb_ibus_config_shm_free(struct wkb_ibus_config_shm *shm);
+void wkb_ibus_config_shm_begin(struct wkb_ibus_config_shm *shm);
+Eina_Bool wkb_ibus_config_shm_add(struct wkb_ibus_config_shm *shm, struct wkb_config_key *key);
+void wkb_ibus_config_shm_end(struct wkb_ibus_config_shm *shm);
+
+/* Reader side, NULL when nothing is published */
+struct wkb_ibus_config_snapshot *wkb_ibus_config_snapshot_get(const char *name);
+void wkb_ibus_config_snapshot_free(struct wkb_ibus_config_snapshot *snapshot);
+unsigned int wkb_ibus_config_snapshot_generation(struct wkb_ibus_config_snapshot *snapshot);
+void wkb_ibus_config_snapshot_dump(struct wkb_ibus_config_snapshot *snapshot);
+
+/* Strings point into the snapshot */
+Eina_Bool wkb_ibus_config_snapshot_get_int(struct wkb_ibus_config_snapshot *snapshot, const char *section, const char *name, int *value);
+Eina_Bool wkb_ibus_config_snapshot_get_bool(struct wkb_ibus_config_snapshot *snapshot, const char *section, const char *name, Eina_Bool *value);
+const char *wkb_ibus_config_snapshot_get_string(struct wkb_ibus_config_snapshot *snapshot, const char *section, const char *name);
+char **wkb_ibus_config_snapshot_get_string_list(struct wkb_ibus_config_snapshot *snapshot, const char *section, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* _WKB_IBUS_CONFIG_SHM_H_ */
@@ -20,6 +20,7 @@
 #include <string.h>
 
 #include <Eina.h>
+#include <Ecore.h>
 #include <Eldbus.h>
 
 #include "wkb-ibus-config.h"
@@ -28,9 +29,37 @@
 #include "wkb-ibus.h"
 #include "wkb-ibus-defs.h"
 #include "wkb-ibus-config-eet.h"
+#include "wkb-ibus-config-shm.h"
 #include "wkb-log.h"
 
 static struct wkb_ibus_config_eet *_conf_eet = NULL;
+static Eldbus_Service_Interface *_ibus_iface = NULL;
+static Eldbus_Service_Interface *_wkb_iface = NULL;
+
+/*
+ * WKB_CONFIG_BACKEND=image serves the read only Eet image from
+ * WKB_CONFIG_IMAGE, which must be set, memory the built in defaults,
+ * neither ever writes.
+ */
+static const char *CONFIG_BACKEND_ENV = "WKB_CONFIG_BACKEND";
+static const char *CONFIG_IMAGE_ENV = "WKB_CONFIG_IMAGE";
+
+/*
+ * WKB_CONFIG_SHM=1 publishes a snapshot of the store in shared memory, for
+ * the instances without it on multi-seat setups. Publishing loads every
+ * section, so it is off by default.
+ */
+static const char *CONFIG_SHM_ENV = "WKB_CONFIG_SHM";
+
+/*
+ * A replaced instance only stops publishing once it sees NameLost, which may
+ * come after the new owner acquired the name.
+ */
+#define CONFIG_SHM_RETRY_DELAY 1.0
+#define CONFIG_SHM_RETRIES 10
+
+static Ecore_Timer *_shm_retry_timer = NULL;
+static int _shm_retries = 0;
 
 #define _config_check_message_errors(_msg) \
    do \
@@ -80,6 +109,15 @@ wkb_ibus_config_get_value_string_list(const char *section, const char *name)
    return wkb_ibus_config_eet_get_value_string_list(_conf_eet, section, name);
 }
 
+const Eina_List *
+wkb_ibus_config_get_value_list(const char *section, const char *name)
+{
+   if (!_conf_eet)
+      return NULL;
+
+   return wkb_ibus_config_eet_get_value_list(_conf_eet, section, name);
+}
+
 struct wkb_config_key *
 wkb_ibus_config_get_key(const char *section, const char *name)
 {
@@ -89,6 +127,24 @@ wkb_ibus_config_get_key(const char *section, const char *name)
    return wkb_ibus_config_eet_find_key(_conf_eet, section, name);
 }
 
+Eina_Bool
+wkb_ibus_config_callback_add(const char *section, const char *name, wkb_config_key_changed_cb cb, const void *data)
+{
+   if (!_conf_eet)
+      return EINA_FALSE;
+
+   return wkb_ibus_config_eet_callback_add(_conf_eet, section, name, cb, data);
+}
+
+void
+wkb_ibus_config_callback_del(const char *section, const char *name, wkb_config_key_changed_cb cb, const void *data)
+{
+   if (!_conf_eet)
+      return;
+
+   wkb_ibus_config_eet_callback_del(_conf_eet, section, name, cb, data);
+}
+
 static Eldbus_Message *
 _config_set_value(const Eldbus_Service_Interface *iface, const Eldbus_Message *msg)
 {
@@ -180,6 +236,46 @@ _config_unset_value(const Eldbus_Service_Interface *iface, const Eldbus_Message
    return eldbus_message_method_return_new(msg);
 }
 
+static Eldbus_Message *
+_config_set_values(const Eldbus_Service_Interface *iface, const Eldbus_Message *msg)
+{
+   Eldbus_Message_Iter *values;
+
+   _config_check_message_errors(msg);
+
+   if (!eldbus_message_arguments_get(msg, "a(ssv)", &values))
+     {
+        ERR("Error reading message arguments");
+        return NULL;
+     }
+
+   if (!wkb_ibus_config_eet_set_values(_conf_eet, values))
+      return eldbus_message_error_new(msg, IBUS_ERROR_FAILED, "Error setting config values");
+
+   return eldbus_message_method_return_new(msg);
+}
+
+static Eldbus_Message *
+_config_get_values_multi(const Eldbus_Service_Interface *iface, const Eldbus_Message *msg)
+{
+   Eldbus_Message *reply = NULL;
+   Eldbus_Message_Iter *names, *iter;
+
+   _config_check_message_errors(msg);
+
+   if (!eldbus_message_arguments_get(msg, "as", &names))
+     {
+        ERR("Error reading message arguments");
+        return NULL;
+     }
+
+   reply = eldbus_message_method_return_new(msg);
+   iter = eldbus_message_iter_get(reply);
+   wkb_ibus_config_eet_get_values_multi(_conf_eet, names, iter);
+
+   return reply;
+}
+
 static const Eldbus_Method _wkb_ibus_config_methods[] =
 {
 /* typedef struct _Eldbus_Method
@@ -235,14 +331,107 @@ static const Eldbus_Service_Interface_Desc _wkb_ibus_config_interface =
    .signals = _wkb_ibus_config_signals,
 };
 
+static const Eldbus_Method _wkb_config_methods[] =
+{
+   { .member = "SetValues",
+     .in = ELDBUS_ARGS({"a(ssv)", "values"}),
+     .cb = _config_set_values, },
+
+   { .member = "GetValuesMulti",
+     .in = ELDBUS_ARGS({"as", "names"}),
+     .out = ELDBUS_ARGS({"a{sv}", "values"}),
+     .cb = _config_get_values_multi, },
+
+   { NULL },
+};
+
+static const Eldbus_Service_Interface_Desc _wkb_config_interface =
+{
+   .interface = WKB_INTERFACE_CONFIG,
+   .methods = _wkb_config_methods,
+};
+
+static Eina_Bool
+_config_shm_enabled(void)
+{
+   const char *env = getenv(CONFIG_SHM_ENV);
+
+   return env && *env && strcmp(env, "0") != 0;
+}
+
+static Eina_Bool
+_config_shm_retry_cb(void *data)
+{
+   if (wkb_ibus_config_eet_publish(_conf_eet, wkb_ibus_config_shm_name()) ||
+       ++_shm_retries >= CONFIG_SHM_RETRIES)
+     {
+        _shm_retry_timer = NULL;
+        return ECORE_CALLBACK_CANCEL;
+     }
+
+   return ECORE_CALLBACK_RENEW;
+}
+
+static void
+_config_shm_publish(void)
+{
+   if (!_config_shm_enabled() || _shm_retry_timer)
+      return;
+
+   if (wkb_ibus_config_eet_publish(_conf_eet, wkb_ibus_config_shm_name()))
+      return;
+
+   _shm_retries = 0;
+   _shm_retry_timer = ecore_timer_add(CONFIG_SHM_RETRY_DELAY, _config_shm_retry_cb, NULL);
+}
+
+static void
+_config_shm_unpublish(void)
+{
+   if (_shm_retry_timer)
+     {
+        ecore_timer_del(_shm_retry_timer);
+        _shm_retry_timer = NULL;
+     }
+
+   wkb_ibus_config_eet_unpublish(_conf_eet);
+}
+
+static struct wkb_ibus_config_eet *
+_config_eet_new(const char *path, Eldbus_Service_Interface *iface)
+{
+   const char *backend = getenv(CONFIG_BACKEND_ENV);
+   const char *image;
+
+   if (!backend || strcmp(backend, "file") == 0)
+      return wkb_ibus_config_eet_new(path, iface);
+
+   if (strcmp(backend, "memory") == 0)
+      return wkb_ibus_config_eet_backend_new(WKB_IBUS_CONFIG_EET_BACKEND_MEMORY, NULL, iface);
+
+   if (strcmp(backend, "image") == 0)
+     {
+        if (!(image = getenv(CONFIG_IMAGE_ENV)) || !*image)
+          {
+             ERR("Config backend 'image' requires %s, using defaults", CONFIG_IMAGE_ENV);
+             return wkb_ibus_config_eet_backend_new(WKB_IBUS_CONFIG_EET_BACKEND_MEMORY, NULL, iface);
+          }
+
+        return wkb_ibus_config_eet_backend_new(WKB_IBUS_CONFIG_EET_BACKEND_IMAGE, image, iface);
+     }
+
+   WRN("Unknown config backend '%s', using file", backend);
+   return wkb_ibus_config_eet_new(path, iface);
+}
+
 Eldbus_Service_Interface *
 wkb_ibus_config_register(Eldbus_Connection *conn, const char *path)
 {
    Eldbus_Service_Interface *ret = NULL;
 
-   if (_conf_eet)
+   if (_ibus_iface)
      {
-        WRN("wkb_config_eet already created\n");
+        WRN("IBusConfig interface already registered\n");
         goto end;
      }
 
@@ -252,14 +441,27 @@ wkb_ibus_config_register(Eldbus_Connection *conn, const char *path)
         goto end;
      }
 
-   _conf_eet = wkb_ibus_config_eet_new(path, ret);
+   /* The store outlives IBus connections, so key handles stay valid */
+   if (_conf_eet)
+      wkb_ibus_config_eet_iface_set(_conf_eet, ret);
+   else
+      _conf_eet = _config_eet_new(path, ret);
 
    if (!_conf_eet)
      {
         eldbus_service_interface_unregister(ret);
         ret = NULL;
+        goto end;
      }
 
+   _ibus_iface = ret;
+
+   /* Published for as long as this instance owns the name */
+   _config_shm_publish();
+
+   if (!(_wkb_iface = eldbus_service_interface_register(conn, IBUS_PATH_CONFIG, &_wkb_config_interface)))
+      WRN("Unable to register weekeyboard Config interface");
+
 end:
    return ret;
 }
@@ -270,6 +472,26 @@ wkb_ibus_config_unregister(void)
    if (!_conf_eet)
       return;
 
+   if (_wkb_iface)
+     {
+        eldbus_service_interface_unregister(_wkb_iface);
+        _wkb_iface = NULL;
+     }
+
+   _config_shm_unpublish();
+
+   wkb_ibus_config_eet_iface_set(_conf_eet, NULL);
+   _ibus_iface = NULL;
+}
+
+void
+wkb_ibus_config_shutdown(void)
+{
+   if (!_conf_eet)
+      return;
+
+   wkb_ibus_config_unregister();
+
    wkb_ibus_config_eet_free(_conf_eet);
    _conf_eet = NULL;
 }
@@ -21,18 +21,26 @@
 #include <Eina.h>
 #include <Eldbus.h>
 
+#include "wkb-ibus-config-key.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-struct wkb_config_key;
-
 int         wkb_ibus_config_get_value_int(const char *section, const char *name);
 Eina_Bool   wkb_ibus_config_get_value_bool(const char *section, const char *name);
 const char *wkb_ibus_config_get_value_string(const char *section, const char *name);
 char      **wkb_ibus_config_get_value_string_list(const char *section, const char *name);
+const Eina_List *wkb_ibus_config_get_value_list(const char *section, const char *name);
 struct wkb_config_key *wkb_ibus_config_get_key(const char *section, const char *name);
 
+/*
+ * Change subscriptions, name NULL subscribes to every key of the section.
+ * Callbacks are called once per main loop iteration with the new value.
+ */
+Eina_Bool wkb_ibus_config_callback_add(const char *section, const char *name, wkb_config_key_changed_cb cb, const void *data);
+void wkb_ibus_config_callback_del(const char *section, const char *name, wkb_config_key_changed_cb cb, const void *data);
+
 #ifdef __cplusplus
 }
 #endif
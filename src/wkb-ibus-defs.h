@@ -40,6 +40,9 @@ extern "C" {
 #define IBUS_ERROR_NO_CONFIG    "org.freedesktop.IBus.Error.NoConfig"
 #define IBUS_ERROR_FAILED       "org.freedesktop.IBus.Error.Failed"
 
+/* weekeyboard extensions, exported next to the IBus interfaces */
+#define WKB_INTERFACE_CONFIG    "org.weekeyboard.Config"
+
 #ifdef __cplusplus
 }
 #endif
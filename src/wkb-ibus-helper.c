@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -148,6 +149,7 @@ wkb_ibus_text_free(struct wkb_ibus_text *text)
    if (!text)
       return;
 
+   eina_stringshare_del(text->text);
    _free_eina_array(text->attrs, (_free_func) free);
    free(text);
 }
@@ -180,6 +182,9 @@ wkb_ibus_text_from_message_iter(Eldbus_Message_Iter *iter)
         goto end;
      }
 
+   /* Strings point into the message, keep our own reference */
+   text->text = eina_stringshare_add(text->text);
+
    DBG("Text.: '%s'", text->text);
 
    if (attrs == NULL)
@@ -289,12 +294,94 @@ end:
    return table;
 }
 
+static unsigned int
+_wkb_ibus_hash_mix(unsigned int hash, uintptr_t value)
+{
+   /* FNV-1a step */
+   return (hash ^ (unsigned int) value) * 16777619u;
+}
+
+static unsigned int
+_wkb_ibus_text_array_hash(unsigned int hash, Eina_Array *array)
+{
+   struct wkb_ibus_text *text;
+   Eina_Array_Iterator iter;
+   unsigned int i;
+
+   if (!array)
+      return _wkb_ibus_hash_mix(hash, 0);
+
+   hash = _wkb_ibus_hash_mix(hash, eina_array_count(array));
+   EINA_ARRAY_ITER_NEXT(array, i, text, iter)
+      hash = _wkb_ibus_hash_mix(hash, (uintptr_t) text->text);
+
+   return hash;
+}
+
+static Eina_Bool
+_wkb_ibus_text_array_equal(Eina_Array *a, Eina_Array *b)
+{
+   struct wkb_ibus_text *ta, *tb;
+   unsigned int i, count;
+
+   count = a ? eina_array_count(a) : 0;
+   if (count != (b ? eina_array_count(b) : 0))
+      return EINA_FALSE;
+
+   for (i = 0; i < count; i++)
+     {
+        ta = eina_array_data_get(a, i);
+        tb = eina_array_data_get(b, i);
+        if (ta->text != tb->text)
+           return EINA_FALSE;
+     }
+
+   return EINA_TRUE;
+}
+
+/*
+ * Texts are stringshares, so they are hashed and compared by pointer. The
+ * cursor is left out on purpose, a table that only differs on it has the
+ * same hash and content.
+ */
+unsigned int
+wkb_ibus_lookup_table_hash(const struct wkb_ibus_lookup_table *table)
+{
+   unsigned int hash = 2166136261u;
+
+   if (!table)
+      return 0;
+
+   hash = _wkb_ibus_hash_mix(hash, table->page_size);
+   hash = _wkb_ibus_hash_mix(hash, table->round);
+   hash = _wkb_ibus_hash_mix(hash, table->orientation);
+   hash = _wkb_ibus_text_array_hash(hash, table->candidates);
+   hash = _wkb_ibus_text_array_hash(hash, table->labels);
+
+   return hash;
+}
+
+Eina_Bool
+wkb_ibus_lookup_table_content_equal(const struct wkb_ibus_lookup_table *a, const struct wkb_ibus_lookup_table *b)
+{
+   if (!a || !b)
+      return a == b;
+
+   return a->page_size == b->page_size &&
+          a->round == b->round &&
+          a->orientation == b->orientation &&
+          _wkb_ibus_text_array_equal(a->candidates, b->candidates) &&
+          _wkb_ibus_text_array_equal(a->labels, b->labels);
+}
+
 void
 wkb_ibus_property_free(struct wkb_ibus_property *property)
 {
    if (!property)
       return;
 
+   eina_stringshare_del(property->key);
+   eina_stringshare_del(property->icon);
    wkb_ibus_text_free(property->label);
    wkb_ibus_text_free(property->symbol);
    wkb_ibus_text_free(property->tooltip);
@@ -327,6 +414,10 @@ wkb_ibus_property_from_message_iter(Eldbus_Message_Iter *iter)
         goto end;
      }
 
+   /* Strings point into the message, keep our own reference */
+   prop->key = eina_stringshare_add(prop->key);
+   prop->icon = eina_stringshare_add(prop->icon);
+
    DBG("Property :");
    DBG("\tKey.............: '%s'", prop->key);
    DBG("\tType............: '%d'", prop->type);
@@ -92,6 +92,8 @@ void wkb_ibus_text_free(struct wkb_ibus_text *text);
 
 struct wkb_ibus_lookup_table *wkb_ibus_lookup_table_from_message_iter(Eldbus_Message_Iter *iter);
 void wkb_ibus_lookup_table_free(struct wkb_ibus_lookup_table *table);
+unsigned int wkb_ibus_lookup_table_hash(const struct wkb_ibus_lookup_table *table);
+Eina_Bool wkb_ibus_lookup_table_content_equal(const struct wkb_ibus_lookup_table *a, const struct wkb_ibus_lookup_table *b);
 
 struct wkb_ibus_property *wkb_ibus_property_from_message_iter(Eldbus_Message_Iter *iter);
 void wkb_ibus_property_free(struct wkb_ibus_property *property);
@@ -19,11 +19,13 @@
 #include <string.h>
 
 #include <Eina.h>
+#include <Ecore.h>
 #include <Eldbus.h>
 
 #include "wkb-ibus.h"
 #include "wkb-ibus-defs.h"
 #include "wkb-ibus-helper.h"
+#include "wkb-ibus-panel.h"
 #include "wkb-log.h"
 
 #define _panel_check_message_errors(_msg) \
@@ -38,6 +40,175 @@
         DBG("Message '%s' with signature '%s'", eldbus_message_member_get(_msg), eldbus_message_signature_get(_msg)); \
      } while (0)
 
+/* Same order as _wkb_ibus_panel_signals */
+enum
+{
+   IBUS_PANEL_SIGNAL_CURSOR_UP = 0,
+   IBUS_PANEL_SIGNAL_CURSOR_DOWN,
+   IBUS_PANEL_SIGNAL_PAGE_UP,
+   IBUS_PANEL_SIGNAL_PAGE_DOWN,
+   IBUS_PANEL_SIGNAL_PROPERTY_ACTIVATE,
+   IBUS_PANEL_SIGNAL_PROPERTY_SHOW,
+   IBUS_PANEL_SIGNAL_PROPERTY_HIDE,
+   IBUS_PANEL_SIGNAL_CANDIDATE_CLICKED,
+};
+
+struct _wkb_ibus_panel
+{
+   Eldbus_Service_Interface *iface;
+
+   Eina_Array *properties;
+   Eina_Hash *properties_index; /* key -> struct wkb_ibus_property, all levels */
+
+   struct wkb_ibus_lookup_table *lookup_table;
+   unsigned int lookup_table_hash;
+   Eina_Bool lookup_table_visible;
+
+   const char *aux_text;
+   Eina_Bool aux_text_visible;
+};
+
+static struct _wkb_ibus_panel *_panel = NULL;
+
+static void
+_panel_property_changed_end_cb(void *data, void *func_data)
+{
+   eina_stringshare_del((const char *) data);
+}
+
+static void
+_panel_property_changed(const char *key)
+{
+   /* NULL key means the whole tree was replaced */
+   key = eina_stringshare_ref(key);
+   ecore_event_add(WKB_IBUS_PROPERTY_CHANGED, (void *) key, _panel_property_changed_end_cb, NULL);
+}
+
+static void
+_panel_lookup_table_changed(void)
+{
+   ecore_event_add(WKB_IBUS_LOOKUP_TABLE_CHANGED, NULL, NULL, NULL);
+}
+
+static void
+_panel_aux_text_set(const char *text, Eina_Bool visible)
+{
+   /* Only bother the UI when what it shows really changed */
+   if (!eina_stringshare_replace(&_panel->aux_text, text) &&
+       _panel->aux_text_visible == visible)
+      return;
+
+   _panel->aux_text_visible = visible;
+   ecore_event_add(WKB_IBUS_AUX_TEXT_CHANGED, NULL, NULL, NULL);
+}
+
+static void
+_panel_lookup_table_cursor_changed(void)
+{
+   ecore_event_add(WKB_IBUS_LOOKUP_TABLE_CURSOR_CHANGED, NULL, NULL, NULL);
+}
+
+static void
+_panel_lookup_table_set(struct wkb_ibus_lookup_table *table, Eina_Bool visible)
+{
+   struct wkb_ibus_lookup_table *cached = _panel->lookup_table;
+   unsigned int hash = wkb_ibus_lookup_table_hash(table);
+   Eina_Bool cursor_changed;
+
+   /*
+    * Engines resend the very same table quite often, only replace it and
+    * have the UI relayout when its content really changed.
+    */
+   if (!cached || !table || hash != _panel->lookup_table_hash ||
+       !wkb_ibus_lookup_table_content_equal(cached, table))
+     {
+        wkb_ibus_lookup_table_free(cached);
+        _panel->lookup_table = table;
+        _panel->lookup_table_hash = hash;
+        _panel->lookup_table_visible = visible;
+        _panel_lookup_table_changed();
+        return;
+     }
+
+   cursor_changed = cached->cursor_pos != table->cursor_pos ||
+                    cached->cursor_visible != table->cursor_visible;
+
+   cached->cursor_pos = table->cursor_pos;
+   cached->cursor_visible = table->cursor_visible;
+   wkb_ibus_lookup_table_free(table);
+
+   if (_panel->lookup_table_visible != visible)
+     {
+        _panel->lookup_table_visible = visible;
+        _panel_lookup_table_changed();
+     }
+   else if (cursor_changed)
+     {
+        DBG("Lookup table cursor moved to '%u'", cached->cursor_pos);
+        _panel_lookup_table_cursor_changed();
+     }
+   else
+     {
+        DBG("Lookup table unchanged");
+     }
+}
+
+static void
+_panel_properties_index(Eina_Array *properties)
+{
+   struct wkb_ibus_property *prop;
+   Eina_Array_Iterator iter;
+   unsigned int i;
+
+   if (!properties)
+      return;
+
+   EINA_ARRAY_ITER_NEXT(properties, i, prop, iter)
+     {
+        if (prop->key)
+           eina_hash_set(_panel->properties_index, prop->key, prop);
+
+        _panel_properties_index(prop->sub_properties);
+     }
+}
+
+static void
+_panel_properties_clear(void)
+{
+   eina_hash_free_buckets(_panel->properties_index);
+   wkb_ibus_properties_free(_panel->properties);
+   _panel->properties = NULL;
+}
+
+static void
+_panel_property_patch(struct wkb_ibus_property *prop, struct wkb_ibus_property *update)
+{
+   struct wkb_ibus_text *tmp;
+
+   /*
+    * Steal the new values and leave the old ones in 'update', so they are
+    * released along with it. Sub properties are updated on their own.
+    */
+   eina_stringshare_replace(&prop->icon, update->icon);
+
+   tmp = prop->label;
+   prop->label = update->label;
+   update->label = tmp;
+
+   tmp = prop->symbol;
+   prop->symbol = update->symbol;
+   update->symbol = tmp;
+
+   tmp = prop->tooltip;
+   prop->tooltip = update->tooltip;
+   update->tooltip = tmp;
+
+   prop->type = update->type;
+   prop->sensitive = update->sensitive;
+   prop->visible = update->visible;
+   prop->state = update->state;
+}
+
 static Eldbus_Message *
 _panel_update_preedit_text(const Eldbus_Service_Interface *iface, const Eldbus_Message *msg)
 {
@@ -96,8 +267,14 @@ _panel_update_auxiliary_text(const Eldbus_Service_Interface *iface, const Eldbus
 
    DBG("text: '%p', visible: '%d'", text, visible);
 
-   ibus_text = wkb_ibus_text_from_message_iter(text);
+   if (!(ibus_text = wkb_ibus_text_from_message_iter(text)))
+      return NULL;
+
    DBG("Auxiliary text = '%s'", ibus_text->text);
+
+   if (_panel)
+      _panel_aux_text_set(ibus_text->text, visible);
+
    wkb_ibus_text_free(ibus_text);
 
    return NULL;
@@ -108,6 +285,9 @@ _panel_show_auxiliary_text(const Eldbus_Service_Interface *iface, const Eldbus_M
 {
    _panel_check_message_errors(msg);
 
+   if (_panel)
+      _panel_aux_text_set(_panel->aux_text, EINA_TRUE);
+
    return NULL;
 }
 
@@ -116,6 +296,9 @@ _panel_hide_auxiliary_text(const Eldbus_Service_Interface *iface, const Eldbus_M
 {
    _panel_check_message_errors(msg);
 
+   if (_panel)
+      _panel_aux_text_set(_panel->aux_text, EINA_FALSE);
+
    return NULL;
 }
 
@@ -137,7 +320,14 @@ _panel_update_lookup_table(const Eldbus_Service_Interface *iface, const Eldbus_M
    DBG("table: '%p', visible: '%d'", table, visible);
 
    ibus_lookup_table = wkb_ibus_lookup_table_from_message_iter(table);
-   wkb_ibus_lookup_table_free(ibus_lookup_table);
+
+   if (!_panel)
+     {
+        wkb_ibus_lookup_table_free(ibus_lookup_table);
+        return NULL;
+     }
+
+   _panel_lookup_table_set(ibus_lookup_table, visible);
 
    return NULL;
 }
@@ -147,6 +337,12 @@ _panel_show_lookup_table(const Eldbus_Service_Interface *iface, const Eldbus_Mes
 {
    _panel_check_message_errors(msg);
 
+   if (!_panel || _panel->lookup_table_visible)
+      return NULL;
+
+   _panel->lookup_table_visible = EINA_TRUE;
+   _panel_lookup_table_changed();
+
    return NULL;
 }
 
@@ -155,6 +351,12 @@ _panel_hide_lookup_table(const Eldbus_Service_Interface *iface, const Eldbus_Mes
 {
    _panel_check_message_errors(msg);
 
+   if (!_panel || !_panel->lookup_table_visible)
+      return NULL;
+
+   _panel->lookup_table_visible = EINA_FALSE;
+   _panel_lookup_table_changed();
+
    return NULL;
 }
 
@@ -207,7 +409,19 @@ _panel_register_properties(const Eldbus_Service_Interface *iface, const Eldbus_M
    DBG("properties: '%p'", props);
 
    properties = wkb_ibus_properties_from_message_iter(props);
-   wkb_ibus_properties_free(properties);
+
+   if (!_panel)
+     {
+        wkb_ibus_properties_free(properties);
+        return NULL;
+     }
+
+   _panel_properties_clear();
+   _panel->properties = properties;
+   _panel_properties_index(properties);
+
+   DBG("Cached %d properties", eina_hash_population(_panel->properties_index));
+   _panel_property_changed(NULL);
 
    return NULL;
 }
@@ -216,6 +430,7 @@ static Eldbus_Message *
 _panel_update_property(const Eldbus_Service_Interface *iface, const Eldbus_Message *msg)
 {
    Eldbus_Message_Iter *prop = NULL;
+   struct wkb_ibus_property *update, *cached;
 
    _panel_check_message_errors(msg);
 
@@ -226,8 +441,24 @@ _panel_update_property(const Eldbus_Service_Interface *iface, const Eldbus_Messa
      }
 
    DBG("property : '%p'", prop);
-   DBG("Property iter signature: %s", eldbus_message_iter_signature_get(prop));
 
+   if (!(update = wkb_ibus_property_from_message_iter(prop)))
+      return NULL;
+
+   if (!_panel || !update->key)
+      goto end;
+
+   if (!(cached = eina_hash_find(_panel->properties_index, update->key)))
+     {
+        INF("Property '%s' was not registered, ignoring", update->key);
+        goto end;
+     }
+
+   _panel_property_patch(cached, update);
+   _panel_property_changed(cached->key);
+
+end:
+   wkb_ibus_property_free(update);
    return NULL;
 }
 
@@ -439,9 +670,127 @@ static const Eldbus_Service_Interface_Desc _wkb_ibus_panel_interface =
    .signals = _wkb_ibus_panel_signals,
 };
 
+Eina_Array *
+wkb_ibus_panel_properties_get(void)
+{
+   if (!_panel)
+      return NULL;
+
+   return _panel->properties;
+}
+
+struct wkb_ibus_property *
+wkb_ibus_panel_property_get(const char *key)
+{
+   if (!_panel || !key)
+      return NULL;
+
+   return eina_hash_find(_panel->properties_index, key);
+}
+
+const struct wkb_ibus_lookup_table *
+wkb_ibus_panel_lookup_table_get(void)
+{
+   if (!_panel || !_panel->lookup_table_visible)
+      return NULL;
+
+   return _panel->lookup_table;
+}
+
+const char *
+wkb_ibus_panel_aux_text_get(void)
+{
+   if (!_panel || !_panel->aux_text_visible)
+      return NULL;
+
+   return _panel->aux_text;
+}
+
+void
+wkb_ibus_panel_candidate_clicked(unsigned int index)
+{
+   if (!_panel)
+      return;
+
+   DBG("Candidate '%u' clicked", index);
+   /* index is relative to the current page, button 1, no modifiers */
+   eldbus_service_signal_emit(_panel->iface, IBUS_PANEL_SIGNAL_CANDIDATE_CLICKED, index, 1, 0);
+}
+
+void
+wkb_ibus_panel_page_up(void)
+{
+   if (!_panel)
+      return;
+
+   eldbus_service_signal_emit(_panel->iface, IBUS_PANEL_SIGNAL_PAGE_UP);
+}
+
+void
+wkb_ibus_panel_page_down(void)
+{
+   if (!_panel)
+      return;
+
+   eldbus_service_signal_emit(_panel->iface, IBUS_PANEL_SIGNAL_PAGE_DOWN);
+}
+
 Eldbus_Service_Interface *
 wkb_ibus_panel_register(Eldbus_Connection *conn)
 {
-   return eldbus_service_interface_register(conn, IBUS_PATH_PANEL, &_wkb_ibus_panel_interface);
+   Eldbus_Service_Interface *ret = NULL;
+
+   if (_panel)
+     {
+        WRN("Panel already registered");
+        goto end;
+     }
+
+   if (!(ret = eldbus_service_interface_register(conn, IBUS_PATH_PANEL, &_wkb_ibus_panel_interface)))
+     {
+        ERR("Unable to register IBusPanel interface");
+        goto end;
+     }
+
+   if (!(_panel = calloc(1, sizeof(*_panel))))
+     {
+        ERR("Error calloc");
+        goto error;
+     }
+
+   _panel->iface = ret;
+   _panel->properties_index = eina_hash_string_superfast_new(NULL);
+
+end:
+   return ret;
+
+error:
+   eldbus_service_interface_unregister(ret);
+   return NULL;
+}
+
+void
+wkb_ibus_panel_unregister(void)
+{
+   if (!_panel)
+      return;
+
+   _panel_properties_clear();
+   eina_hash_free(_panel->properties_index);
+
+   if (_panel->lookup_table)
+     {
+        wkb_ibus_lookup_table_free(_panel->lookup_table);
+        _panel_lookup_table_changed();
+     }
+
+   if (_panel->aux_text)
+     {
+        eina_stringshare_del(_panel->aux_text);
+        ecore_event_add(WKB_IBUS_AUX_TEXT_CHANGED, NULL, NULL, NULL);
+     }
+
+   free(_panel);
+   _panel = NULL;
 }
 
@@ -0,0 +1,60 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _WKB_IBUS_PANEL_H_
+#define _WKB_IBUS_PANEL_H_
+
+#include <Eina.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct wkb_ibus_property;
+struct wkb_ibus_lookup_table;
+
+/*
+ * Property tree of the current engine, as sent by RegisterProperties and
+ * kept up to date by UpdateProperty. Owned by the panel, valid until the
+ * next WKB_IBUS_PROPERTY_CHANGED event with a NULL key.
+ */
+Eina_Array *wkb_ibus_panel_properties_get(void);
+struct wkb_ibus_property *wkb_ibus_panel_property_get(const char *key);
+
+/*
+ * Lookup table last sent by the engine, NULL while hidden. Owned by the
+ * panel, valid until the next WKB_IBUS_LOOKUP_TABLE_CHANGED event. When
+ * only the cursor moved WKB_IBUS_LOOKUP_TABLE_CURSOR_CHANGED is posted
+ * instead.
+ */
+const struct wkb_ibus_lookup_table *wkb_ibus_panel_lookup_table_get(void);
+void wkb_ibus_panel_candidate_clicked(unsigned int index);
+
+/*
+ * Auxiliary text (e.g. the raw pinyin buffer), NULL while hidden. It is a
+ * stringshare owned by the panel, WKB_IBUS_AUX_TEXT_CHANGED is only posted
+ * when the text or its visibility change.
+ */
+const char *wkb_ibus_panel_aux_text_get(void);
+
+void wkb_ibus_panel_page_up(void);
+void wkb_ibus_panel_page_down(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WKB_IBUS_PANEL_H_ */
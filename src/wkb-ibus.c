@@ -32,7 +32,6 @@
 #include "wkb-log.h"
 #include "wkb-ibus-config.h"
 #include "wkb-ibus-config-eet.h"
-#include "wkb-ibus-config-key.h"
 
 #include "input-method-client-protocol.h"
 
@@ -50,8 +49,10 @@
 
 int WKB_IBUS_CONNECTED = 0;
 int WKB_IBUS_DISCONNECTED = 0;
-int WKB_IBUS_CONFIG_VALUE_CHANGED = 0;
-int WKB_THEME_CHANGED = 0;
+int WKB_IBUS_PROPERTY_CHANGED = 0;
+int WKB_IBUS_LOOKUP_TABLE_CHANGED = 0;
+int WKB_IBUS_LOOKUP_TABLE_CURSOR_CHANGED = 0;
+int WKB_IBUS_AUX_TEXT_CHANGED = 0;
 
 static const char *IBUS_ADDRESS_ENV = "IBUS_ADDRESS";
 static const char *IBUS_ADDRESS_CMD = "ibus address";
@@ -111,66 +112,6 @@ struct _wkb_ibus_context
 
 static struct _wkb_ibus_context *wkb_ibus = NULL;
 
-static void
-_wkb_theme_changed_end_cb(void *data, void *func_data)
-{
-   const char *theme = (const char *) data;
-   eina_stringshare_del(theme);
-}
-
-static void
-_wkb_config_theme_changed(struct wkb_config_key *key)
-{
-   const char *theme;
-   if (!(theme = wkb_config_key_get_string(key)))
-     {
-       DBG("Error retrieving theme value");
-       return;
-     }
-
-   DBG("New theme '%s'", theme);
-   eina_stringshare_ref(theme);
-   ecore_event_add(WKB_THEME_CHANGED, (void *) theme, _wkb_theme_changed_end_cb, (void *) theme);
-}
-
-static void
-_wkb_config_value_changed_end_cb(void *data, void *func_data)
-{
-   /* do nothing. this function only exists because if we do not define
-    * a callback, smart ecore will free data passed to the event. */
-}
-
-static void
-_wkb_config_value_changed_cb(void *data, const Eldbus_Message *msg)
-{
-   const char *section, *name;
-   Eldbus_Message_Iter *value;
-   struct wkb_config_key *key;
-
-   _check_message_errors(msg);
-
-   if (!eldbus_message_arguments_get(msg, "ssv", &section, &name, &value))
-     {
-        ERR("Error reading message arguments");
-        return;
-     }
-
-   INF("ValueChanged: section: '%s', name: '%s'", section, name);
-
-   /* Emit general CONFIG_VALUE_CHANGED event */
-   if (!(key = wkb_ibus_config_get_key(section, name)))
-     {
-        ERR("Config key '%s' or section '%s' not found", section, name);
-        return;
-     }
-
-   ecore_event_add(WKB_IBUS_CONFIG_VALUE_CHANGED, key, _wkb_config_value_changed_end_cb, NULL);
-
-   /* If theme changed, emit specific THEME_CHANGED event */
-   if (strncmp(section, "weekeyboard", strlen("weekeyboard")) == 0 && strncmp(name, "theme", strlen("theme")) == 0)
-      _wkb_config_theme_changed(key);
-}
-
 static void
 _wkb_name_owner_changed_cb(void *data, const char *bus, const char *old_id, const char *new_id)
 {
@@ -203,12 +144,6 @@ _wkb_name_acquired_cb(void *data, const Eldbus_Message *msg)
         wkb_ibus->config = wkb_ibus_config_register(wkb_ibus->conn, path);
         eina_stringshare_del(path);
         INF("Registering Config Interface: %s", wkb_ibus->config ? "Success" : "Fail");
-        if (wkb_ibus->config)
-          {
-             Eldbus_Object *obj = eldbus_object_get(wkb_ibus->conn, IBUS_SERVICE_CONFIG, IBUS_PATH_CONFIG);
-             Eldbus_Proxy *config = eldbus_proxy_get(obj, IBUS_INTERFACE_CONFIG);
-             eldbus_proxy_signal_handler_add(config, "ValueChanged", _wkb_config_value_changed_cb, wkb_ibus);
-          }
      }
    else
      {
@@ -232,6 +167,14 @@ _wkb_name_lost_cb(void *data, const Eldbus_Message *msg)
      }
 
    DBG("Name = %s", name);
+
+   /* Replaced by another instance, which now serves and publishes the config */
+   if (strncmp(name, IBUS_INTERFACE_CONFIG, strlen(IBUS_INTERFACE_CONFIG)) == 0 && wkb_ibus->config)
+     {
+        wkb_ibus_config_unregister();
+        eldbus_service_interface_unregister(wkb_ibus->config);
+        wkb_ibus->config = NULL;
+     }
 }
 
 static Eina_Bool
@@ -397,6 +340,7 @@ static void
 _wkb_ibus_disconnected_cb(void *data, Eldbus_Connection *conn, void *event_data)
 {
    DBG("Lost connection to IBus daemon");
+   wkb_ibus_panel_unregister();
    wkb_ibus_config_unregister();
 
    free(wkb_ibus->address);
@@ -571,8 +515,10 @@ wkb_ibus_init(void)
 
    WKB_IBUS_CONNECTED = ecore_event_type_new();
    WKB_IBUS_DISCONNECTED = ecore_event_type_new();
-   WKB_IBUS_CONFIG_VALUE_CHANGED = ecore_event_type_new();
-   WKB_THEME_CHANGED = ecore_event_type_new();
+   WKB_IBUS_PROPERTY_CHANGED = ecore_event_type_new();
+   WKB_IBUS_LOOKUP_TABLE_CHANGED = ecore_event_type_new();
+   WKB_IBUS_LOOKUP_TABLE_CURSOR_CHANGED = ecore_event_type_new();
+   WKB_IBUS_AUX_TEXT_CHANGED = ecore_event_type_new();
 
    wkb_ibus->add_handle = ecore_event_handler_add(ECORE_EXE_EVENT_ADD, _wkb_ibus_exe_add_cb, NULL);
    wkb_ibus->data_handle = ecore_event_handler_add(ECORE_EXE_EVENT_DATA, _wkb_ibus_exe_data_cb, NULL);
@@ -601,6 +547,8 @@ _wkb_ibus_shutdown_finish(void)
    ecore_event_handler_del(wkb_ibus->add_handle);
    ecore_event_handler_del(wkb_ibus->data_handle);
 
+   wkb_ibus_config_shutdown();
+
    free(wkb_ibus);
    wkb_ibus = NULL;
 
@@ -684,6 +632,7 @@ wkb_ibus_disconnect(void)
 
    if (wkb_ibus->panel)
      {
+        wkb_ibus_panel_unregister();
         eldbus_service_interface_unregister(wkb_ibus->panel);
         wkb_ibus->panel = NULL;
      }
@@ -916,7 +865,7 @@ _ibus_input_ctx_key_press(void *data, const Eldbus_Message *msg, Eldbus_Pending
 
    if (!ret)
      {
-        INF("Key press was not handled by IBus (code = '%u', sym = '%u' modifiers = '%u')", key->code, key->sym, key->modifiers);
+        DBG("Key press was not handled by IBus (code = '%u', sym = '%u' modifiers = '%u')", key->code, key->sym, key->modifiers);
         if (key->modifiers)
            wl_input_method_context_modifiers(wkb_ibus->input_ctx->wl_ctx,
                                              wkb_ibus->input_ctx->serial,
@@ -944,7 +893,7 @@ _ibus_input_ctx_key_release(void *data, const Eldbus_Message *msg, Eldbus_Pendin
 
    if (!ret)
      {
-        INF("Key release was not handled by IBus (code = '%u', sym = '%u' modifiers = '%u')", key->code, key->sym, key->modifiers);
+        DBG("Key release was not handled by IBus (code = '%u', sym = '%u' modifiers = '%u')", key->code, key->sym, key->modifiers);
         wl_input_method_context_key(wkb_ibus->input_ctx->wl_ctx,
                                     wkb_ibus->input_ctx->serial,
                                     0, key->code-8, WL_KEYBOARD_KEY_STATE_RELEASED);
@@ -1118,7 +1067,7 @@ wkb_ibus_input_context_process_key_event(const char *key_str)
 
    key.code += 8;
 
-   INF("Process key event with '%s', code= 0x%x (%d), modifiers = 0x%x", key_str, key.code, key.code, key.modifiers);
+   DBG("Process key event with '%s', code= 0x%x (%d), modifiers = 0x%x", key_str, key.code, key.code, key.modifiers);
 
    /* Key press */
    if (!wkb_ibus->input_ctx->ibus_ctx)
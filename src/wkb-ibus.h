@@ -29,8 +29,10 @@ struct wl_input_method_context;
 /* Events */
 extern int WKB_IBUS_CONNECTED;
 extern int WKB_IBUS_DISCONNECTED;
-extern int WKB_IBUS_CONFIG_VALUE_CHANGED;
-extern int WKB_THEME_CHANGED;
+extern int WKB_IBUS_PROPERTY_CHANGED;
+extern int WKB_IBUS_LOOKUP_TABLE_CHANGED;
+extern int WKB_IBUS_LOOKUP_TABLE_CURSOR_CHANGED;
+extern int WKB_IBUS_AUX_TEXT_CHANGED;
 
 int wkb_ibus_init(void);
 Eina_Bool wkb_ibus_shutdown(void);
@@ -50,10 +52,12 @@ void wkb_ibus_input_context_set_serial(unsigned int serial);
 
 /* IBus Panel */
 Eldbus_Service_Interface * wkb_ibus_panel_register(Eldbus_Connection *conn);
+void wkb_ibus_panel_unregister(void);
 
 /* IBus Config */
 Eldbus_Service_Interface * wkb_ibus_config_register(Eldbus_Connection *conn, const char *path);
 void wkb_ibus_config_unregister(void);
+void wkb_ibus_config_shutdown(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the cost of a filtered out log call on the key path before and
+ * after the WKB_LOG gating:
+ *
+ *    EINA_LOG_LEVELS=log-bench:2 ./weekeyboard-log-bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <Eina.h>
+
+#include "wkb-log.h"
+
+#define BENCH_ITERATIONS 1000000
+
+static unsigned int _arg_evaluations = 0;
+
+/* Stands for eldbus_message_*_signature_get() and friends */
+static const char *
+_bench_expensive_arg(unsigned int code)
+{
+   static char buf[64];
+
+   _arg_evaluations++;
+   snprintf(buf, sizeof(buf), "key-%u:(uuu)", code);
+
+   return buf;
+}
+
+static double
+_bench_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void
+_bench_report(const char *name, unsigned int iterations, double elapsed)
+{
+   printf("%-8s %10u calls %10.3f ms %8.2f ns/call %10u arg evaluations\n",
+          name, iterations, elapsed * 1000.0,
+          elapsed * 1000000000.0 / iterations, _arg_evaluations);
+}
+
+int
+main (int argc, char *argv[])
+{
+   unsigned int i, iterations = BENCH_ITERATIONS;
+   double start;
+
+   if (argc > 1)
+      iterations = strtoul(argv[1], NULL, 10);
+
+   if (!iterations)
+      return 1;
+
+   if (!wkb_log_init("log-bench"))
+      return 1;
+
+   printf("log level: %d, compiled in up to: %d\n",
+          eina_log_domain_registered_level_get(_wkb_log_domain), WKB_LOG_LEVEL_MAX);
+
+   /* Before: the previous INF() expansion, arguments always evaluated */
+   _arg_evaluations = 0;
+   start = _bench_now();
+   for (i = 0; i < iterations; i++)
+      EINA_LOG_DOM_INFO(_wkb_log_domain, "Process key event with '%s', code= 0x%x (%d)",
+                        _bench_expensive_arg(i), i, i);
+   _bench_report("before", iterations, _bench_now() - start);
+
+   /* After: gated DBG() */
+   _arg_evaluations = 0;
+   start = _bench_now();
+   for (i = 0; i < iterations; i++)
+      DBG("Process key event with '%s', code= 0x%x (%d)",
+          _bench_expensive_arg(i), i, i);
+   _bench_report("after", iterations, _bench_now() - start);
+
+   wkb_log_shutdown();
+
+   return 0;
+}
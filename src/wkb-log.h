@@ -17,18 +17,41 @@
 #ifndef _WKB_LOG_H_
 #define _WKB_LOG_H_
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <Eina.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * Highest level compiled in, see --with-max-log-level. Messages above it are
+ * dead code, messages below it are only formatted when the domain level at
+ * runtime lets them through, so arguments are never evaluated for nothing.
+ */
+#ifndef WKB_LOG_LEVEL_MAX
+#define WKB_LOG_LEVEL_MAX EINA_LOG_LEVEL_DBG
+#endif
+
 extern int _wkb_log_domain;
-#define DBG(...)      EINA_LOG_DOM_DBG(_wkb_log_domain, __VA_ARGS__)
-#define INF(...)      EINA_LOG_DOM_INFO(_wkb_log_domain, __VA_ARGS__)
-#define WRN(...)      EINA_LOG_DOM_WARN(_wkb_log_domain, __VA_ARGS__)
-#define ERR(...)      EINA_LOG_DOM_ERR(_wkb_log_domain, __VA_ARGS__)
-#define CRITICAL(...) EINA_LOG_DOM_CRIT(_wkb_log_domain, __VA_ARGS__)
+
+#define WKB_LOG(_lvl, ...)                                                 \
+   do                                                                      \
+     {                                                                     \
+        if ((_lvl) <= WKB_LOG_LEVEL_MAX &&                                 \
+            eina_log_domain_level_check(_wkb_log_domain, (_lvl)))          \
+           EINA_LOG(_wkb_log_domain, (_lvl), __VA_ARGS__);                 \
+     }                                                                     \
+   while (0)
+
+#define DBG(...)      WKB_LOG(EINA_LOG_LEVEL_DBG, __VA_ARGS__)
+#define INF(...)      WKB_LOG(EINA_LOG_LEVEL_INFO, __VA_ARGS__)
+#define WRN(...)      WKB_LOG(EINA_LOG_LEVEL_WARN, __VA_ARGS__)
+#define ERR(...)      WKB_LOG(EINA_LOG_LEVEL_ERR, __VA_ARGS__)
+#define CRITICAL(...) WKB_LOG(EINA_LOG_LEVEL_CRITICAL, __VA_ARGS__)
 
 int wkb_log_init(const char *domain);
 void wkb_log_shutdown(void);
@@ -33,22 +33,109 @@
 #include "wkb-log.h"
 #include "wkb-ibus.h"
 #include "wkb-ibus-config.h"
+#include "wkb-ibus-config-key.h"
+#include "wkb-ibus-config-shm.h"
+#include "wkb-ibus-helper.h"
+#include "wkb-ibus-panel.h"
 
 #include "input-method-client-protocol.h"
 #include "text-client-protocol.h"
 
+/* Themes kept loaded, so switching back and forth does not hit the disk */
+#define WKB_THEME_CACHE_SIZE 3
+
+/*
+ * Themes are laid out for screens WKB_THEME_BASE_WIDTH pixels wide and scaled
+ * to the actual width. Past 1080 pixels the keyboard stops growing.
+ */
+#define WKB_THEME_BASE_WIDTH 720
+#define WKB_THEME_SCALE_MAX 1.5
+
+/* How often an instance without the config store looks for a new snapshot */
+#define WKB_CONFIG_SNAPSHOT_POLL 2.0
+
+/*
+ * Set to "1" to log the damage and render time of every frame, along with a
+ * summary on exit. Set to "verify" to also warn when a key press or release
+ * damages the keyboard outside of the key itself.
+ */
+static const char *RENDER_STATS_ENV = "WKB_RENDER_STATS";
+
+/* Evas rounds damage to its tiles, allow for that around the key */
+#define WKB_RENDER_DAMAGE_SLACK 8
+
+/* Render statistics of one canvas */
+struct _wkb_render_stats
+{
+   const char *name;
+   unsigned int bytes_per_pixel; /* written to shm buffers, 0 with EGL */
+   double start;
+
+   unsigned int frames;
+   unsigned int rects;
+   unsigned long long pixels;
+   double time, time_max;
+
+   /* Damage the next frame may have, after a key press or release */
+   Eina_Bool verify;
+   Eina_Bool expecting;
+   Eina_Rectangle expected;
+   double expected_time;
+   unsigned int checks, violations;
+};
+
+/* A loaded theme, ready to be shown */
+struct _wkb_theme
+{
+   char *name;
+   double scale;
+   Evas_Object *edje_obj;
+   Evas_Coord w, h;
+   unsigned int candidate_slots;
+   char **ignore_keys;
+
+   Evas_Object *hint_obj; /* on hint_ee, NULL if the theme has no hints */
+   Evas_Coord hint_w, hint_h, hint_gap;
+};
+
 struct weekeyboard
 {
    Ecore_Evas *ee;
    Ecore_Wl_Window *win;
-   Evas_Object *edje_obj;
+   Evas_Object *edje_obj; /* of the current theme */
    const char *ee_engine;
-   char **ignore_keys;
+   char **ignore_keys; /* of the current theme */
+   unsigned int candidate_slots;
+   unsigned int candidate_page_start;
+   int candidate_selected;
+   Ecore_Event_Handler *lookup_table_handler;
+   Ecore_Event_Handler *lookup_table_cursor_handler;
+   Ecore_Event_Handler *aux_text_handler;
+   Ecore_Event_Handler *signal_exit_handler;
+   const char *aux_text;
+   struct wkb_config_key *theme_key;
+   Ecore_Timer *snapshot_timer; /* while reading the theme from a snapshot */
+   unsigned int snapshot_generation;
+
+   Eina_List *themes; /* struct _wkb_theme, most recently used first */
+   struct _wkb_theme *current_theme;
+   struct _wkb_theme *pending_theme; /* swapped in by theme_animator */
+   Ecore_Animator *theme_animator;
+
+   /* Key press hints, on a small subsurface above the pressed key */
+   Ecore_Evas *hint_ee;
+   struct wl_subsurface *hint_subsurface;
+   const char *hint_source; /* key of the hint shown, if any */
+
+   /* WKB_RENDER_STATS */
+   struct _wkb_render_stats render_stats;
+   struct _wkb_render_stats hint_render_stats;
 
    struct wl_surface *surface;
    struct wl_input_panel *ip;
    struct wl_input_method *im;
    struct wl_output *output;
+   struct wl_subcompositor *subcompositor;
    struct wl_input_method_context *im_ctx;
 
    char *surrounding_text;
@@ -63,6 +150,8 @@ struct weekeyboard
    uint32_t surrounding_cursor;
 
    Eina_Bool context_changed;
+   Eina_Bool candidates_visible;
+   Eina_Bool aux_text_visible;
 };
 
 static Eina_Bool _wkb_ui_setup(struct weekeyboard *wkb);
@@ -74,6 +163,14 @@ _cb_wkb_delete_request(Ecore_Evas *ee)
       ecore_main_loop_quit();
 }
 
+/* SIGINT, SIGTERM and friends, pending config changes are committed by main() */
+static Eina_Bool
+_wkb_event_signal_exit_cb(void *data, int type, void *event)
+{
+   ecore_main_loop_quit();
+   return ECORE_CALLBACK_PASS_ON;
+}
+
 static char *
 _wkb_insert_text(const char *text, uint32_t offset, const char *insert)
 {
@@ -189,6 +286,224 @@ end:
    free(src);
 }
 
+static void
+_wkb_input_region_update(struct weekeyboard *wkb)
+{
+   int x, y, w, h;
+   int cx, cy, cw, ch;
+
+   if (!wkb->win)
+      return;
+
+   /*
+    * The keyboard surface leaves room above the background for the candidate
+    * strip and the auxiliary text. Here we resize the input region of the
+    * surface to match the keyboard background image, so that we can pass
+    * mouse events to the surfaces that may be located below the keyboard.
+    * The candidate strip is added to the region while it is shown.
+    */
+   edje_object_part_geometry_get(wkb->edje_obj, "background", &x, &y, &w, &h);
+
+   if (wkb->candidates_visible &&
+       edje_object_part_geometry_get(wkb->edje_obj, "candidates", &cx, &cy, &cw, &ch) &&
+       cy < y)
+     {
+        h += y - cy;
+        y = cy;
+     }
+
+   ecore_wl_window_input_region_set(wkb->win, x, y, w, h);
+}
+
+static void
+_wkb_candidates_visible_set(struct weekeyboard *wkb, Eina_Bool visible)
+{
+   unsigned int i;
+   char part[32];
+
+   if (wkb->candidates_visible == visible)
+      return;
+
+   wkb->candidates_visible = visible;
+   edje_object_signal_emit(wkb->edje_obj, visible ? "candidates,show" : "candidates,hide", "");
+
+   /* The slots are not clipped by the strip, hide their words along with it */
+   if (!visible)
+     {
+        for (i = 0; i < wkb->candidate_slots; i++)
+          {
+             snprintf(part, sizeof(part), "candidate-%u", i);
+             edje_object_signal_emit(wkb->edje_obj, "candidate,hide", part);
+          }
+
+        wkb->candidate_selected = -1;
+     }
+
+   _wkb_input_region_update(wkb);
+}
+
+static void
+_wkb_candidates_update(struct weekeyboard *wkb)
+{
+   const struct wkb_ibus_lookup_table *table;
+   struct wkb_ibus_text *candidate;
+   unsigned int i, count, page_size, page_start;
+   char part[32];
+
+   if (!wkb->edje_obj || !wkb->candidate_slots)
+      return;
+
+   table = wkb_ibus_panel_lookup_table_get();
+   if (!table || !table->candidates || !(count = eina_array_count(table->candidates)))
+     {
+        _wkb_candidates_visible_set(wkb, EINA_FALSE);
+        return;
+     }
+
+   /* The slots are a fixed pool from the theme, only their text changes */
+   page_size = table->page_size;
+   if (!page_size || page_size > wkb->candidate_slots)
+      page_size = wkb->candidate_slots;
+
+   page_start = table->cursor_pos - (table->cursor_pos % page_size);
+   wkb->candidate_page_start = page_start;
+   wkb->candidate_selected = -1;
+
+   for (i = 0; i < wkb->candidate_slots; i++)
+     {
+        snprintf(part, sizeof(part), "candidate-%u", i);
+
+        if (i >= page_size || page_start + i >= count)
+          {
+             edje_object_signal_emit(wkb->edje_obj, "candidate,hide", part);
+             continue;
+          }
+
+        candidate = eina_array_data_get(table->candidates, page_start + i);
+        edje_object_part_text_set(wkb->edje_obj, part, candidate->text);
+
+        if (table->cursor_visible && page_start + i == table->cursor_pos)
+          {
+             edje_object_signal_emit(wkb->edje_obj, "candidate,select", part);
+             wkb->candidate_selected = i;
+          }
+        else
+           edje_object_signal_emit(wkb->edje_obj, "candidate,show", part);
+     }
+
+   _wkb_candidates_visible_set(wkb, EINA_TRUE);
+}
+
+static void
+_wkb_candidates_cursor_update(struct weekeyboard *wkb)
+{
+   const struct wkb_ibus_lookup_table *table;
+   unsigned int page_size;
+   int selected = -1;
+   char part[32];
+
+   if (!wkb->edje_obj || !wkb->candidates_visible)
+      return;
+
+   if (!(table = wkb_ibus_panel_lookup_table_get()))
+      return;
+
+   page_size = table->page_size;
+   if (!page_size || page_size > wkb->candidate_slots)
+      page_size = wkb->candidate_slots;
+
+   /* Cursor moved to another page, all the labels change */
+   if (table->cursor_pos < wkb->candidate_page_start ||
+       table->cursor_pos >= wkb->candidate_page_start + page_size)
+     {
+        _wkb_candidates_update(wkb);
+        return;
+     }
+
+   if (table->cursor_visible)
+      selected = table->cursor_pos - wkb->candidate_page_start;
+
+   if (selected == wkb->candidate_selected)
+      return;
+
+   /* Only move the highlight, texts and layout stay untouched */
+   if (wkb->candidate_selected >= 0)
+     {
+        snprintf(part, sizeof(part), "candidate-%d", wkb->candidate_selected);
+        edje_object_signal_emit(wkb->edje_obj, "candidate,show", part);
+     }
+
+   if (selected >= 0)
+     {
+        snprintf(part, sizeof(part), "candidate-%d", selected);
+        edje_object_signal_emit(wkb->edje_obj, "candidate,select", part);
+     }
+
+   wkb->candidate_selected = selected;
+}
+
+static Eina_Bool
+_wkb_event_lookup_table_changed_cb(void *data, int type, void *event)
+{
+   _wkb_candidates_update(data);
+
+   return ECORE_CALLBACK_PASS_ON;
+}
+
+static Eina_Bool
+_wkb_event_lookup_table_cursor_changed_cb(void *data, int type, void *event)
+{
+   _wkb_candidates_cursor_update(data);
+
+   return ECORE_CALLBACK_PASS_ON;
+}
+
+static void
+_wkb_aux_text_update(struct weekeyboard *wkb)
+{
+   const char *text;
+   Eina_Bool visible;
+
+   if (!wkb->edje_obj)
+      return;
+
+   text = wkb_ibus_panel_aux_text_get();
+
+   /* Keep the last text while hidden, so showing it again is just a state change */
+   if (text && eina_stringshare_replace(&wkb->aux_text, text))
+      edje_object_part_text_set(wkb->edje_obj, "auxiliary-text", text);
+
+   visible = text && *text;
+   if (visible == wkb->aux_text_visible)
+      return;
+
+   wkb->aux_text_visible = visible;
+   edje_object_signal_emit(wkb->edje_obj, visible ? "auxiliary,show" : "auxiliary,hide", "");
+}
+
+static Eina_Bool
+_wkb_event_aux_text_changed_cb(void *data, int type, void *event)
+{
+   _wkb_aux_text_update(data);
+
+   return ECORE_CALLBACK_PASS_ON;
+}
+
+static void
+_cb_wkb_on_candidate_clicked(void *data, Evas_Object *obj, const char *emission, const char *source)
+{
+   wkb_ibus_panel_candidate_clicked(strtoul(source, NULL, 10));
+}
+
+static void
+_cb_wkb_on_candidate_page(void *data, Evas_Object *obj, const char *emission, const char *source)
+{
+   if (strcmp(emission, "candidate,page,up") == 0)
+      wkb_ibus_panel_page_up();
+   else
+      wkb_ibus_panel_page_down();
+}
+
 static void
 _wkb_im_ctx_surrounding_text(void *data, struct wl_input_method_context *im_ctx, const char *text, uint32_t cursor, uint32_t anchor)
 {
@@ -364,6 +679,15 @@ _wkb_im_activate(void *data, struct wl_input_method *input_method, struct wl_inp
    evas_object_show(wkb->edje_obj);
 }
 
+static void
+_wkb_hint_hide(struct weekeyboard *wkb)
+{
+   if (wkb->current_theme && wkb->current_theme->hint_obj)
+      evas_object_hide(wkb->current_theme->hint_obj);
+
+   eina_stringshare_replace(&wkb->hint_source, NULL);
+}
+
 static void
 _wkb_im_deactivate(void *data, struct wl_input_method *input_method, struct wl_input_method_context *im_ctx)
 {
@@ -381,6 +705,8 @@ _wkb_im_deactivate(void *data, struct wl_input_method *input_method, struct wl_i
 
    if (wkb->edje_obj)
       evas_object_hide(wkb->edje_obj);
+
+   _wkb_hint_hide(wkb);
 }
 
 static const struct wl_input_method_listener wkb_im_listener = {
@@ -389,109 +715,628 @@ static const struct wl_input_method_listener wkb_im_listener = {
 };
 
 
+static void
+_wkb_theme_key_changed_cb(void *data, struct wkb_config_key *key, const union wkb_config_value *value)
+{
+   struct weekeyboard *wkb = data;
+
+   DBG("Theme changed to '%s'", value->s);
+   _wkb_ui_setup(wkb);
+}
+
+/*
+ * Hint signals come from the keys in the group parts, with "<group>:<key>" as
+ * source. Gets the group part holding the key, the key name and the canvas
+ * geometry of the key image.
+ */
 static Eina_Bool
-_wkb_ui_setup(struct weekeyboard *wkb)
+_wkb_key_geometry_get(Evas_Object *obj, const char *source, const Evas_Object **group, const char **key, Eina_Rectangle *geometry)
 {
-   char path[PATH_MAX];
-   int w = 1080, h;
-   char *ignore_keys;
-   const char *theme;
+   char part[64];
+   Evas_Coord gx, gy;
 
-   /* First run */
-   if (!wkb->edje_obj)
+   if (!(*key = strchr(source, ':')) || *key - source >= (int) sizeof(part))
+      return EINA_FALSE;
+
+   snprintf(part, sizeof(part), "%.*s", (int) (*key - source), source);
+   (*key)++;
+
+   if (!(*group = edje_object_part_object_get(obj, part)))
+      return EINA_FALSE;
+
+   snprintf(part, sizeof(part), "key-img-%s", *key);
+   if (!edje_object_part_geometry_get(*group, part, &geometry->x, &geometry->y, &geometry->w, &geometry->h))
+      return EINA_FALSE;
+
+   evas_object_geometry_get(*group, &gx, &gy, NULL, NULL);
+   geometry->x += gx;
+   geometry->y += gy;
+
+   return EINA_TRUE;
+}
+
+/*
+ * The hint is moved right above the key image and shows its label, or the
+ * alternative one on long press.
+ */
+static void
+_cb_wkb_on_key_hint(void *data, Evas_Object *obj, const char *emission, const char *source)
+{
+   struct weekeyboard *wkb = data;
+   struct _wkb_theme *theme = wkb->current_theme;
+   const Evas_Object *group;
+   const char *key, *label;
+   char part[64];
+   Eina_Rectangle geometry;
+
+   if (!theme || theme->edje_obj != obj || !theme->hint_obj)
+      return;
+
+   /* Releases of other keys may come after the next press */
+   if (strcmp(emission, "hint,hide") == 0)
      {
-        Evas *evas;
-        ecore_evas_alpha_set(wkb->ee, EINA_TRUE);
-        ecore_evas_title_set(wkb->ee, "Weekeyboard");
+        if (wkb->hint_source && strcmp(source, wkb->hint_source) == 0)
+           _wkb_hint_hide(wkb);
+        return;
+     }
+
+   if (!_wkb_key_geometry_get(obj, source, &group, &key, &geometry))
+      return;
+
+   snprintf(part, sizeof(part), "%s%s", strcmp(emission, "hint,alt") ? "key-lbl-" : "key-lbl-alt-", key);
+   label = edje_object_part_text_get(group, part);
+   edje_object_part_text_set(theme->hint_obj, "label", label ? label : "");
+
+   /* Applied with the next commit of the keyboard, which draws the pressed key */
+   wl_subsurface_set_position(wkb->hint_subsurface, geometry.x, geometry.y - theme->hint_gap - theme->hint_h);
+   evas_object_show(theme->hint_obj);
+   eina_stringshare_replace(&wkb->hint_source, source);
+}
+
+/*
+ * Key presses and releases should only damage the key. The expectation is
+ * set as the press or release starts, and holds for one frame interval.
+ */
+static void
+_cb_wkb_render_expect(void *data, Evas_Object *obj, const char *emission, const char *source)
+{
+   struct _wkb_render_stats *stats = data;
+   const Evas_Object *group;
+   const char *key;
+   Eina_Rectangle geometry;
+   double now = ecore_time_get();
+
+   if (!_wkb_key_geometry_get(obj, source, &group, &key, &geometry))
+      return;
 
-        evas = ecore_evas_get(wkb->ee);
-        wkb->edje_obj = edje_object_add(evas);
-        edje_object_signal_callback_add(wkb->edje_obj, "key_down", "*", _cb_wkb_on_key_down, wkb);
+   geometry.x -= WKB_RENDER_DAMAGE_SLACK;
+   geometry.y -= WKB_RENDER_DAMAGE_SLACK;
+   geometry.w += 2 * WKB_RENDER_DAMAGE_SLACK;
+   geometry.h += 2 * WKB_RENDER_DAMAGE_SLACK;
+
+   /* Press and release may land in the same frame */
+   if (stats->expecting && now - stats->expected_time <= ecore_animator_frametime_get())
+      eina_rectangle_union(&stats->expected, &geometry);
+   else
+      stats->expected = geometry;
+
+   stats->expecting = EINA_TRUE;
+   stats->expected_time = now;
+}
+
+static void
+_cb_wkb_render_pre(void *data, Evas *evas, void *event_info)
+{
+   struct _wkb_render_stats *stats = data;
+
+   stats->start = ecore_time_get();
+}
+
+static void
+_cb_wkb_render_post(void *data, Evas *evas, void *event_info)
+{
+   struct _wkb_render_stats *stats = data;
+   Evas_Event_Render_Post *ev = event_info;
+   double time = ecore_time_get() - stats->start;
+   unsigned long long pixels = 0;
+   unsigned int rects = 0;
+   Eina_Bool expected = EINA_TRUE;
+   Eina_Rectangle *r;
+   Eina_List *l;
+
+   if (!ev || !ev->updated_area)
+      return;
+
+   /* Nothing was drawn for the key in time, this frame is about something else */
+   if (stats->expecting && stats->start - stats->expected_time > ecore_animator_frametime_get())
+      stats->expecting = EINA_FALSE;
+
+   EINA_LIST_FOREACH(ev->updated_area, l, r)
+     {
+        DBG("Render '%s': damage %dx%d+%d+%d", stats->name, r->w, r->h, r->x, r->y);
+
+        pixels += (unsigned long long) r->w * r->h;
+        rects++;
+
+        if (stats->expecting &&
+            (r->x < stats->expected.x || r->y < stats->expected.y ||
+             r->x + r->w > stats->expected.x + stats->expected.w ||
+             r->y + r->h > stats->expected.y + stats->expected.h))
+           expected = EINA_FALSE;
      }
 
-   /* Bail out if theme did not change */
-   if (!(theme = wkb_ibus_config_get_value_string("weekeyboard", "theme")))
-      theme = "default";
+   stats->frames++;
+   stats->rects += rects;
+   stats->pixels += pixels;
+   stats->time += time;
 
-   if (wkb->theme && strcmp(theme, wkb->theme) == 0)
-      return EINA_TRUE;
+   if (time > stats->time_max)
+      stats->time_max = time;
 
-   free(wkb->theme);
-   wkb->theme = strdup(theme);
+   DBG("Render '%s': %u rects, %llu pixels, %llu bytes, %.3f ms",
+       stats->name, rects, pixels, pixels * stats->bytes_per_pixel, time * 1000);
+
+   if (!stats->expecting)
+      return;
+
+   stats->checks++;
+   stats->expecting = EINA_FALSE;
 
-   if (strcmp(wkb->theme, "default") == 0)
+   if (!expected)
      {
-        /* Check which theme we should use according to the screen width */
-        ecore_wl_screen_size_get(&w, &h);
-        DBG("Screen size: w=%d, h=%d", w, h);
-        if (w >= 1080)
-           w = 1080;
-        else if (w >= 720)
-           w = 720;
-        else
-           w = 600;
+        stats->violations++;
+        WRN("Render '%s': key damage exceeds %dx%d+%d+%d", stats->name,
+            stats->expected.w, stats->expected.h, stats->expected.x, stats->expected.y);
+     }
+}
+
+static void
+_wkb_render_stats_add(struct weekeyboard *wkb, Ecore_Evas *ee, struct _wkb_render_stats *stats, const char *name)
+{
+   Evas *evas = ecore_evas_get(ee);
+
+   stats->name = name;
+   stats->bytes_per_pixel = strcmp(wkb->ee_engine, "wayland_shm") == 0 ? 4 : 0;
+
+   evas_event_callback_add(evas, EVAS_CALLBACK_RENDER_PRE, _cb_wkb_render_pre, stats);
+   evas_event_callback_add(evas, EVAS_CALLBACK_RENDER_POST, _cb_wkb_render_post, stats);
+}
+
+static void
+_wkb_render_stats_setup(struct weekeyboard *wkb)
+{
+   const char *env = getenv(RENDER_STATS_ENV);
+
+   if (!env || !*env || strcmp(env, "0") == 0)
+      return;
 
-        DBG("Using default_%d theme", w);
+   wkb->render_stats.verify = strcmp(env, "verify") == 0;
+
+   _wkb_render_stats_add(wkb, wkb->ee, &wkb->render_stats, "keyboard");
+
+   if (wkb->hint_ee)
+      _wkb_render_stats_add(wkb, wkb->hint_ee, &wkb->hint_render_stats, "hint");
+
+   INF("Render statistics enabled%s", wkb->render_stats.verify ? ", verifying key damage" : "");
+}
+
+static void
+_wkb_render_stats_report(struct _wkb_render_stats *stats)
+{
+   if (!stats->name)
+      return;
+
+   INF("Render '%s': %u frames, %u damage rects, %llu pixels (%llu bytes), %.3f ms per frame (%.3f max), %u of %u key damage checks failed",
+       stats->name, stats->frames, stats->rects, stats->pixels, stats->pixels * stats->bytes_per_pixel,
+       stats->frames ? stats->time * 1000 / stats->frames : 0.0, stats->time_max * 1000,
+       stats->violations, stats->checks);
+}
+
+/*
+ * The hint never takes presses, they go through to the keyboard. Ecore_Wl
+ * only knows how to set a region covering the whole surface, so an empty
+ * one is set directly, and again whenever Ecore_Evas resizes the surface.
+ */
+static void
+_wkb_hint_input_region_clear(Ecore_Evas *ee)
+{
+   struct wl_surface *surface = ecore_wl_window_surface_get(ecore_evas_wayland_window_get(ee));
+   struct wl_region *region;
+
+   if (!surface)
+      return;
+
+   region = wl_compositor_create_region(ecore_wl_compositor_get());
+   wl_surface_set_input_region(surface, region);
+   wl_region_destroy(region);
+}
+
+static void
+_wkb_hint_setup(struct weekeyboard *wkb)
+{
+   Ecore_Wl_Window *win;
+   struct wl_surface *surface;
+
+   if (!wkb->subcompositor)
+     {
+        INF("No wl_subcompositor, key press hints disabled");
+        return;
      }
 
-   sprintf(path, PKGDATADIR"/%s_%d.edj", wkb->theme, w);
-   INF("Loading edje file: '%s'", path);
+   if (!(wkb->hint_ee = ecore_evas_new(wkb->ee_engine, 0, 0, 1, 1, "frame=0")))
+     {
+        ERR("Unable to create Ecore_Evas object for key press hints");
+        return;
+     }
+
+   ecore_evas_alpha_set(wkb->hint_ee, EINA_TRUE);
+   win = ecore_evas_wayland_window_get(wkb->hint_ee);
+   ecore_wl_window_type_set(win, ECORE_WL_WINDOW_TYPE_NONE);
+   surface = ecore_wl_window_surface_create(win);
+
+   /* Hints are drawn as keys are pressed, not along with the keyboard */
+   wkb->hint_subsurface = wl_subcompositor_get_subsurface(wkb->subcompositor, surface, wkb->surface);
+   wl_subsurface_set_desync(wkb->hint_subsurface);
 
-   if (!edje_object_file_set(wkb->edje_obj, path, "main"))
+   ecore_evas_callback_resize_set(wkb->hint_ee, _wkb_hint_input_region_clear);
+   ecore_evas_show(wkb->hint_ee);
+   _wkb_hint_input_region_clear(wkb->hint_ee);
+}
+
+static void
+_wkb_theme_hint_load(struct weekeyboard *wkb, struct _wkb_theme *theme, const char *path)
+{
+   Evas_Coord w, h;
+   const char *gap;
+
+   theme->hint_obj = edje_object_add(ecore_evas_get(wkb->hint_ee));
+
+   if (!edje_object_file_set(theme->hint_obj, path, "hint"))
      {
-        int err = edje_object_load_error_get(wkb->edje_obj);
+        DBG("No key press hints in: '%s'", path);
+        evas_object_del(theme->hint_obj);
+        theme->hint_obj = NULL;
+        return;
+     }
+
+   edje_object_scale_set(theme->hint_obj, theme->scale);
+
+   /* The group min size is not scaled by Edje, unlike the parts */
+   edje_object_size_min_get(theme->hint_obj, &w, &h);
+   theme->hint_w = w * theme->scale + 0.5;
+   theme->hint_h = h * theme->scale + 0.5;
+
+   gap = edje_object_data_get(theme->hint_obj, "gap");
+   theme->hint_gap = gap ? strtol(gap, NULL, 10) * theme->scale + 0.5 : 0;
+
+   evas_object_move(theme->hint_obj, 0, 0);
+   evas_object_resize(theme->hint_obj, theme->hint_w, theme->hint_h);
+}
+
+static void
+_wkb_theme_free(struct _wkb_theme *theme)
+{
+   evas_object_del(theme->edje_obj);
+
+   if (theme->hint_obj)
+      evas_object_del(theme->hint_obj);
+
+   if (theme->ignore_keys)
+     {
+        free(*theme->ignore_keys);
+        free(theme->ignore_keys);
+     }
+
+   free(theme->name);
+   free(theme);
+}
+
+/*
+ * The edje object is created hidden, so the theme is fully prepared while the
+ * current one is still on screen.
+ */
+static struct _wkb_theme *
+_wkb_theme_load(struct weekeyboard *wkb, const char *name, double scale)
+{
+   struct _wkb_theme *theme;
+   char path[PATH_MAX];
+   Evas_Coord w, h;
+   char *ignore_keys;
+   const char *slots;
+
+   snprintf(path, sizeof(path), PKGDATADIR"/%s.edj", name);
+   INF("Loading edje file: '%s' at scale %.3f", path, scale);
+
+   theme = calloc(1, sizeof(*theme));
+   theme->name = strdup(name);
+   theme->scale = scale;
+   theme->edje_obj = edje_object_add(ecore_evas_get(wkb->ee));
+
+   if (!edje_object_file_set(theme->edje_obj, path, "main"))
+     {
+        int err = edje_object_load_error_get(theme->edje_obj);
         ERR("Unable to load the edje file: '%s'", edje_load_error_str(err));
-        return EINA_FALSE;
+        _wkb_theme_free(theme);
+        return NULL;
+     }
+
+   edje_object_signal_callback_add(theme->edje_obj, "key_down", "*", _cb_wkb_on_key_down, wkb);
+   edje_object_signal_callback_add(theme->edje_obj, "candidate,clicked", "*", _cb_wkb_on_candidate_clicked, wkb);
+   edje_object_signal_callback_add(theme->edje_obj, "candidate,page,*", "*", _cb_wkb_on_candidate_page, wkb);
+   edje_object_signal_callback_add(theme->edje_obj, "hint,*", "*", _cb_wkb_on_key_hint, wkb);
+
+   if (wkb->render_stats.verify)
+     {
+        edje_object_signal_callback_add(theme->edje_obj, "key_pressed", "*", _cb_wkb_render_expect, &wkb->render_stats);
+        edje_object_signal_callback_add(theme->edje_obj, "key_released", "*", _cb_wkb_render_expect, &wkb->render_stats);
      }
 
-   edje_object_size_min_get(wkb->edje_obj, &w, &h);
+   edje_object_scale_set(theme->edje_obj, scale);
+
+   /* The group min size is not scaled by Edje, unlike the parts */
+   edje_object_size_min_get(theme->edje_obj, &w, &h);
+   w = w * scale + 0.5;
+   h = h * scale + 0.5;
    DBG("edje_object_size_min_get -  w: %d h: %d", w, h);
    if (w == 0 || h == 0)
      {
-        edje_object_size_min_restricted_calc(wkb->edje_obj, &w, &h, w, h);
+        edje_object_size_min_restricted_calc(theme->edje_obj, &w, &h, w, h);
         DBG("edje_object_size_min_restricted_calc -  w: %d h: %d", w, h);
         if (w == 0 || h == 0)
           {
-             edje_object_parts_extends_calc(wkb->edje_obj, NULL, NULL, &w, &h);
+             edje_object_parts_extends_calc(theme->edje_obj, NULL, NULL, &w, &h);
              DBG("edje_object_parts_extends_calc -  w: %d h: %d", w, h);
           }
      }
 
-   ecore_evas_move_resize(wkb->ee, 0, 0, w, h);
-   evas_object_move(wkb->edje_obj, 0, 0);
-   evas_object_resize(wkb->edje_obj, w, h);
-   evas_object_size_hint_min_set(wkb->edje_obj, w, h);
-   evas_object_size_hint_max_set(wkb->edje_obj, w, h);
+   theme->w = w;
+   theme->h = h;
+   evas_object_move(theme->edje_obj, 0, 0);
+   evas_object_resize(theme->edje_obj, w, h);
+   evas_object_size_hint_min_set(theme->edje_obj, w, h);
+   evas_object_size_hint_max_set(theme->edje_obj, w, h);
 
-   /*
-    * The keyboard surface is bigger than it appears so that we can show the
-    * key pressed animation without requiring the use of subsurfaces. Here we
-    * resize the input region of the surface to match the keyboard background
-    * image, so that we can pass mouse events to the surfaces that may be
-    * located below the keyboard.
-    */
-   if (wkb->win)
-     {
-        int x, y, w, h;
+   /* Candidate strip, themes without one simply do not show candidates */
+   slots = edje_object_data_get(theme->edje_obj, "candidate-slots");
+   theme->candidate_slots = slots ? strtoul(slots, NULL, 10) : 0;
+   DBG("Theme has %u candidate slots", theme->candidate_slots);
 
-        edje_object_part_geometry_get(wkb->edje_obj, "background", &x, &y, &w, &h);
-        ecore_wl_window_input_region_set(wkb->win, x, y, w, h);
-     }
+   if (wkb->hint_ee)
+      _wkb_theme_hint_load(wkb, theme, path);
 
    /* special keys */
-   ignore_keys = edje_file_data_get(path, "ignore-keys");
-   if (!ignore_keys)
+   if (!(ignore_keys = edje_file_data_get(path, "ignore-keys")))
      {
         ERR("Special keys file not found in: '%s'", path);
-        goto end;
+        return theme;
      }
 
    DBG("Got ignore keys: '%s'", ignore_keys);
-   wkb->ignore_keys = eina_str_split(ignore_keys, "\n", 0);
+   theme->ignore_keys = eina_str_split(ignore_keys, "\n", 0);
    free(ignore_keys);
 
-end:
+   return theme;
+}
+
+static Eina_Bool
+_wkb_theme_in_use(struct weekeyboard *wkb, struct _wkb_theme *theme)
+{
+   return theme == wkb->current_theme || theme == wkb->pending_theme;
+}
+
+static struct _wkb_theme *
+_wkb_theme_get(struct weekeyboard *wkb, const char *name, double scale)
+{
+   struct _wkb_theme *theme;
+   Eina_List *node;
+
+   EINA_LIST_FOREACH(wkb->themes, node, theme)
+     {
+        if (theme->scale != scale || strcmp(theme->name, name))
+           continue;
+
+        DBG("Using cached theme '%s' at scale %.3f", name, scale);
+        wkb->themes = eina_list_promote_list(wkb->themes, node);
+        return theme;
+     }
+
+   if (!(theme = _wkb_theme_load(wkb, name, scale)))
+      return NULL;
+
+   wkb->themes = eina_list_prepend(wkb->themes, theme);
+
+   /* Evict the least recently used ones, never those on or about to be on screen */
+   node = eina_list_last(wkb->themes);
+   while (node && eina_list_count(wkb->themes) > WKB_THEME_CACHE_SIZE)
+     {
+        Eina_List *prev = eina_list_prev(node);
+        struct _wkb_theme *old = eina_list_data_get(node);
+
+        if (old != theme && !_wkb_theme_in_use(wkb, old))
+          {
+             DBG("Dropping cached theme '%s' at scale %.3f", old->name, old->scale);
+             wkb->themes = eina_list_remove_list(wkb->themes, node);
+             _wkb_theme_free(old);
+          }
+
+        node = prev;
+     }
+
+   return theme;
+}
+
+static void
+_wkb_theme_apply(struct weekeyboard *wkb, struct _wkb_theme *theme)
+{
+   Evas_Object *old = wkb->edje_obj;
+
+   /* A hint left over by the previous theme */
+   _wkb_hint_hide(wkb);
+
+   if (theme->hint_obj)
+      ecore_evas_resize(wkb->hint_ee, theme->hint_w, theme->hint_h);
+
+   wkb->current_theme = theme;
+   wkb->edje_obj = theme->edje_obj;
+   wkb->ignore_keys = theme->ignore_keys;
+   wkb->candidate_slots = theme->candidate_slots;
+
+   ecore_evas_move_resize(wkb->ee, 0, 0, theme->w, theme->h);
+
+   /* The new object takes over the visibility of the previous one */
+   if (old && old != theme->edje_obj)
+     {
+        if (evas_object_visible_get(old))
+           evas_object_show(theme->edje_obj);
+        evas_object_hide(old);
+     }
+
+   /*
+    * A cached theme comes back with the strips it was last shown with, hide
+    * them for real and let the updates show what is current.
+    */
+   wkb->candidates_visible = EINA_TRUE;
+   _wkb_candidates_visible_set(wkb, EINA_FALSE);
+   _wkb_candidates_update(wkb);
+
+   /* The text part may hold what was shown the last time the theme was used */
+   eina_stringshare_replace(&wkb->aux_text, NULL);
+   wkb->aux_text_visible = EINA_FALSE;
+   edje_object_signal_emit(wkb->edje_obj, "auxiliary,hide", "");
+   _wkb_aux_text_update(wkb);
+
    ecore_evas_show(wkb->ee);
+}
+
+/* Runs right before the next frame is rendered, so the swap is never seen half done */
+static Eina_Bool
+_wkb_theme_swap_cb(void *data)
+{
+   struct weekeyboard *wkb = data;
+   struct _wkb_theme *theme = wkb->pending_theme;
+
+   wkb->theme_animator = NULL;
+   wkb->pending_theme = NULL;
+
+   if (theme)
+      _wkb_theme_apply(wkb, theme);
+
+   return ECORE_CALLBACK_CANCEL;
+}
+
+/* The owner bumps the generation each time it publishes */
+static Eina_Bool
+_wkb_snapshot_poll_cb(void *data)
+{
+   struct weekeyboard *wkb = data;
+   struct wkb_ibus_config_snapshot *snapshot;
+   unsigned int generation;
+
+   if (!(snapshot = wkb_ibus_config_snapshot_get(wkb_ibus_config_shm_name())))
+      return ECORE_CALLBACK_RENEW;
+
+   generation = wkb_ibus_config_snapshot_generation(snapshot);
+   wkb_ibus_config_snapshot_free(snapshot);
+
+   if (generation == wkb->snapshot_generation)
+      return ECORE_CALLBACK_RENEW;
+
+   /* Polling starts over if the theme still comes from a snapshot */
+   wkb->snapshot_timer = NULL;
+   _wkb_ui_setup(wkb);
+
+   return ECORE_CALLBACK_CANCEL;
+}
+
+static Eina_Bool
+_wkb_ui_setup(struct weekeyboard *wkb)
+{
+   int w = WKB_THEME_BASE_WIDTH, h;
+   double scale;
+   const char *theme = NULL;
+   struct wkb_ibus_config_snapshot *snapshot = NULL;
+   struct _wkb_theme *entry;
+
+   /* First run */
+   if (!wkb->current_theme)
+     {
+        ecore_evas_alpha_set(wkb->ee, EINA_TRUE);
+        ecore_evas_title_set(wkb->ee, "Weekeyboard");
+     }
+
+   /* The key is resolved once, the config store keeps it for the whole session */
+   if (!wkb->theme_key && (wkb->theme_key = wkb_ibus_config_get_key("weekeyboard", "theme")))
+      wkb_ibus_config_callback_add("weekeyboard", "theme", _wkb_theme_key_changed_cb, wkb);
+
+   /* Without the config store, another instance may have published it */
+   if (wkb->theme_key)
+     {
+        theme = wkb_config_key_get_string(wkb->theme_key);
+
+        /* Changes are notified by the store from now on */
+        if (wkb->snapshot_timer)
+          {
+             ecore_timer_del(wkb->snapshot_timer);
+             wkb->snapshot_timer = NULL;
+          }
+     }
+   else
+     {
+        if ((snapshot = wkb_ibus_config_snapshot_get(wkb_ibus_config_shm_name())))
+          {
+             wkb->snapshot_generation = wkb_ibus_config_snapshot_generation(snapshot);
+             theme = wkb_ibus_config_snapshot_get_string(snapshot, "weekeyboard", "theme");
+          }
+
+        if (!wkb->snapshot_timer)
+           wkb->snapshot_timer = ecore_timer_add(WKB_CONFIG_SNAPSHOT_POLL, _wkb_snapshot_poll_cb, wkb);
+     }
+
+   if (!theme || !*theme)
+      theme = "default";
+
+   /* Bail out if theme did not change */
+   if (wkb->theme && strcmp(theme, wkb->theme) == 0)
+     {
+        wkb_ibus_config_snapshot_free(snapshot);
+        return EINA_TRUE;
+     }
+
+   free(wkb->theme);
+   wkb->theme = strdup(theme);
+   wkb_ibus_config_snapshot_free(snapshot);
+
+   /* Scale the theme to the screen width */
+   ecore_wl_screen_size_get(&w, &h);
+   DBG("Screen size: w=%d, h=%d", w, h);
+
+   scale = (double) w / WKB_THEME_BASE_WIDTH;
+   if (scale <= 0.0)
+      scale = 1.0;
+   else if (scale > WKB_THEME_SCALE_MAX)
+      scale = WKB_THEME_SCALE_MAX;
+
+   if (!(entry = _wkb_theme_get(wkb, wkb->theme, scale)))
+     {
+        /* Try again next time */
+        free(wkb->theme);
+        wkb->theme = NULL;
+        return EINA_FALSE;
+     }
+
+   /* Nothing on screen yet, no frame to wait for */
+   if (!wkb->current_theme)
+     {
+        _wkb_theme_apply(wkb, entry);
+        return EINA_TRUE;
+     }
+
+   /* Switched back before the swap happened */
+   wkb->pending_theme = (entry == wkb->current_theme) ? NULL : entry;
+
+   if (wkb->pending_theme && !wkb->theme_animator)
+      wkb->theme_animator = ecore_animator_add(_wkb_theme_swap_cb, wkb);
+
    return EINA_TRUE;
 }
 
@@ -524,6 +1369,11 @@ _wkb_setup(struct weekeyboard *wkb)
            wkb->output = wl_registry_bind(registry, global->id, &wl_output_interface, 1);
            DBG("binding wl_output");
         }
+        else if (strcmp(global->interface, "wl_subcompositor") == 0)
+        {
+           wkb->subcompositor = wl_registry_bind(registry, global->id, &wl_subcompositor_interface, 1);
+           DBG("binding wl_subcompositor");
+        }
      }
 
    /* invalidate the UI so it is drawn when invoked */
@@ -537,6 +1387,9 @@ _wkb_setup(struct weekeyboard *wkb)
    ips = wl_input_panel_get_input_panel_surface(wkb->ip, wkb->surface);
    wl_input_panel_surface_set_toplevel(ips, wkb->output, WL_INPUT_PANEL_SURFACE_POSITION_CENTER_BOTTOM);
 
+   _wkb_hint_setup(wkb);
+   _wkb_render_stats_setup(wkb);
+
    /* Input method listener */
    DBG("Adding wl_input_method listener");
    wl_input_method_add_listener(wkb->im, &wkb_im_listener, wkb);
@@ -547,17 +1400,46 @@ _wkb_setup(struct weekeyboard *wkb)
 static void
 _wkb_free(struct weekeyboard *wkb)
 {
+   struct _wkb_theme *theme;
+
    if (wkb->im_ctx)
       wl_input_method_context_destroy(wkb->im_ctx);
 
-   if (wkb->edje_obj)
-      evas_object_del(wkb->edje_obj);
+   if (wkb->theme_animator)
+      ecore_animator_del(wkb->theme_animator);
 
-   if (wkb->ignore_keys)
-     {
-        free(*wkb->ignore_keys);
-        free(wkb->ignore_keys);
-     }
+   EINA_LIST_FREE(wkb->themes, theme)
+      _wkb_theme_free(theme);
+
+   _wkb_render_stats_report(&wkb->render_stats);
+   _wkb_render_stats_report(&wkb->hint_render_stats);
+
+   if (wkb->hint_subsurface)
+      wl_subsurface_destroy(wkb->hint_subsurface);
+
+   if (wkb->hint_ee)
+      ecore_evas_free(wkb->hint_ee);
+
+   if (wkb->subcompositor)
+      wl_subcompositor_destroy(wkb->subcompositor);
+
+   if (wkb->lookup_table_handler)
+      ecore_event_handler_del(wkb->lookup_table_handler);
+
+   if (wkb->lookup_table_cursor_handler)
+      ecore_event_handler_del(wkb->lookup_table_cursor_handler);
+
+   if (wkb->aux_text_handler)
+      ecore_event_handler_del(wkb->aux_text_handler);
+
+   if (wkb->signal_exit_handler)
+      ecore_event_handler_del(wkb->signal_exit_handler);
+
+   if (wkb->snapshot_timer)
+      ecore_timer_del(wkb->snapshot_timer);
+
+   eina_stringshare_del(wkb->aux_text);
+   eina_stringshare_del(wkb->hint_source);
 
    free(wkb->preedit_str);
    free(wkb->surrounding_text);
@@ -643,13 +1525,32 @@ main(int argc, char **argv)
    _wkb_setup(&wkb);
 
    wkb_ibus_init();
+   wkb.lookup_table_handler = ecore_event_handler_add(WKB_IBUS_LOOKUP_TABLE_CHANGED,
+                                                      _wkb_event_lookup_table_changed_cb,
+                                                      &wkb);
+   wkb.lookup_table_cursor_handler = ecore_event_handler_add(WKB_IBUS_LOOKUP_TABLE_CURSOR_CHANGED,
+                                                             _wkb_event_lookup_table_cursor_changed_cb,
+                                                             &wkb);
+   wkb.aux_text_handler = ecore_event_handler_add(WKB_IBUS_AUX_TEXT_CHANGED,
+                                                  _wkb_event_aux_text_changed_cb,
+                                                  &wkb);
    wkb_ibus_connect();
 
    ecore_evas_callback_delete_request_set(wkb.ee, _cb_wkb_delete_request);
+   wkb.signal_exit_handler = ecore_event_handler_add(ECORE_EVENT_SIGNAL_EXIT,
+                                                     _wkb_event_signal_exit_cb,
+                                                     &wkb);
 
    ecore_timer_add(1, _wkb_check_ibus_connection, NULL);
    ecore_main_loop_begin();
 
+   /*
+    * Only a complete IBus shutdown commits the config store, the loop may
+    * also be left on a signal or while disconnected. Debounced changes would
+    * be lost otherwise.
+    */
+   wkb_ibus_config_shutdown();
+
    ret = EXIT_SUCCESS;
 
    _wkb_free(&wkb);